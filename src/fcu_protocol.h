@@ -0,0 +1,245 @@
+// FCU 面板串口协议（插件与 tools/fcu_emulator.cpp 共用）
+//
+// 帧格式（多字节字段均为小端）：
+//   0xA5 | type | seq_lo | seq_hi | len | payload[len] | crc_lo | crc_hi
+// CRC 为 CRC-16/CCITT-FALSE，覆盖 type 到 payload 末尾。
+// 每个方向各自维护 16 位递增序号，接收方据此发现丢帧和乱序。
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace fcu {
+
+const uint8_t kFrameSync = 0xA5;
+const size_t kFrameHeaderSize = 5;
+const size_t kFrameMaxPayload = 32;
+const size_t kFrameMaxSize = kFrameHeaderSize + kFrameMaxPayload + 2;
+
+enum FrameType : uint8_t {
+    kFrameState = 0x01,  // 插件 → 面板：FCU 显示状态（变化时发送，另有 1 秒心跳）
+    kFrameAck   = 0x02,  // 插件 → 面板：确认收到的输入帧
+    kFrameInput = 0x10   // 面板 → 插件：旋钮/按钮输入
+};
+
+// 面板控件
+enum Control : uint8_t {
+    kControlSPD = 0,
+    kControlHDG,
+    kControlALT,
+    kControlVS,
+    kControlAP1,
+    kControlAP2,
+    kControlCount
+};
+
+// 输入动作
+enum InputAction : uint8_t {
+    kActionTurn = 0,  // 旋钮转动，delta 为格数（正为顺时针）
+    kActionPush,      // 旋钮按下 / 按钮按下
+    kActionPull       // 旋钮拔出
+};
+
+// State 帧中的标志位
+enum StateFlags : uint8_t {
+    kStateHDGTRK     = 1 << 0,
+    kStateMach       = 1 << 1,
+    kStateSPDManaged = 1 << 2,
+    kStateHDGManaged = 1 << 3,
+    kStateAP1        = 1 << 4,
+    kStateAP2        = 1 << 5
+};
+
+struct StatePayload {
+    int32_t spd1000;       // SPD(kts) 或 MACH，乘以 1000
+    int16_t hdg;
+    int32_t alt;
+    int16_t vs;
+    int16_t fpa10;         // FPA 乘以 10
+    uint8_t verticalMode;  // AirbusFBW/APVerticalMode
+    uint8_t flags;         // StateFlags
+};
+
+struct InputPayload {
+    uint8_t control;  // Control
+    uint8_t action;   // InputAction
+    int8_t delta;
+};
+
+struct AckPayload {
+    uint16_t inputSeq;  // 被确认的输入帧序号
+};
+
+const size_t kStatePayloadSize = 16;
+const size_t kInputPayloadSize = 3;
+const size_t kAckPayloadSize = 2;
+
+inline uint16_t Crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= static_cast<uint16_t>(data[i]) << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+inline void PutU16(uint8_t* p, uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+inline void PutU32(uint8_t* p, uint32_t v) { PutU16(p, v & 0xFFFF); PutU16(p + 2, v >> 16); }
+inline uint16_t GetU16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+inline uint32_t GetU32(const uint8_t* p) { return GetU16(p) | (static_cast<uint32_t>(GetU16(p + 2)) << 16); }
+
+// 组帧，返回帧长度（out 至少 kFrameMaxSize 字节）
+inline size_t EncodeFrame(uint8_t type, uint16_t seq, const uint8_t* payload, size_t len, uint8_t* out)
+{
+    if (len > kFrameMaxPayload) return 0;
+    out[0] = kFrameSync;
+    out[1] = type;
+    PutU16(out + 2, seq);
+    out[4] = static_cast<uint8_t>(len);
+    if (len > 0) memcpy(out + kFrameHeaderSize, payload, len);
+    PutU16(out + kFrameHeaderSize + len, Crc16(out + 1, kFrameHeaderSize - 1 + len));
+    return kFrameHeaderSize + len + 2;
+}
+
+inline size_t EncodeState(const StatePayload& s, uint8_t* out)
+{
+    PutU32(out, static_cast<uint32_t>(s.spd1000));
+    PutU16(out + 4, static_cast<uint16_t>(s.hdg));
+    PutU32(out + 6, static_cast<uint32_t>(s.alt));
+    PutU16(out + 10, static_cast<uint16_t>(s.vs));
+    PutU16(out + 12, static_cast<uint16_t>(s.fpa10));
+    out[14] = s.verticalMode;
+    out[15] = s.flags;
+    return kStatePayloadSize;
+}
+
+inline bool DecodeState(const uint8_t* p, size_t len, StatePayload& s)
+{
+    if (len < kStatePayloadSize) return false;
+    s.spd1000 = static_cast<int32_t>(GetU32(p));
+    s.hdg = static_cast<int16_t>(GetU16(p + 4));
+    s.alt = static_cast<int32_t>(GetU32(p + 6));
+    s.vs = static_cast<int16_t>(GetU16(p + 10));
+    s.fpa10 = static_cast<int16_t>(GetU16(p + 12));
+    s.verticalMode = p[14];
+    s.flags = p[15];
+    return true;
+}
+
+inline size_t EncodeInput(const InputPayload& in, uint8_t* out)
+{
+    out[0] = in.control;
+    out[1] = in.action;
+    out[2] = static_cast<uint8_t>(in.delta);
+    return kInputPayloadSize;
+}
+
+inline bool DecodeInput(const uint8_t* p, size_t len, InputPayload& in)
+{
+    if (len < kInputPayloadSize) return false;
+    in.control = p[0];
+    in.action = p[1];
+    in.delta = static_cast<int8_t>(p[2]);
+    return true;
+}
+
+inline size_t EncodeAck(const AckPayload& ack, uint8_t* out)
+{
+    PutU16(out, ack.inputSeq);
+    return kAckPayloadSize;
+}
+
+inline bool DecodeAck(const uint8_t* p, size_t len, AckPayload& ack)
+{
+    if (len < kAckPayloadSize) return false;
+    ack.inputSeq = GetU16(p);
+    return true;
+}
+
+struct Frame {
+    uint8_t type;
+    uint16_t seq;
+    uint8_t len;
+    uint8_t payload[kFrameMaxPayload];
+};
+
+// 逐字节解帧：每送入一个字节后反复调用 Next() 直到返回 kNeedMore
+// 长度非法或 CRC 错误时只丢弃帧头的同步字节，从已缓存字节中的下一个 0xA5 重新同步，
+// 避免一个误认的同步字节吞掉后面的真实帧
+class FrameDecoder {
+public:
+    enum Result {
+        kNeedMore = 0,
+        kFrameReady,  // frame() 中是一帧完整的数据
+        kCRCError     // receivedCrc()/computedCrc() 为出错帧的 CRC
+    };
+
+    void Reset() { mLen = 0; }
+
+    void Put(uint8_t byte) {
+        // 上次 Next() 返回 kNeedMore 时缓存的字节不足一帧，这里不会溢出
+        if (mLen < kFrameMaxSize) mBuf[mLen++] = byte;
+    }
+
+    Result Next() {
+        for (;;) {
+            // 跳到下一个同步字节
+            size_t sync = 0;
+            while (sync < mLen && mBuf[sync] != kFrameSync) sync++;
+            mSkipped += static_cast<uint32_t>(sync);
+            Consume(sync);
+
+            if (mLen < kFrameHeaderSize) return kNeedMore;
+
+            size_t len = mBuf[4];
+            if (len > kFrameMaxPayload) {
+                mSkipped++;
+                Consume(1);
+                continue;
+            }
+            size_t total = kFrameHeaderSize + len + 2;
+            if (mLen < total) return kNeedMore;
+
+            mReceivedCrc = GetU16(mBuf + kFrameHeaderSize + len);
+            mComputedCrc = Crc16(mBuf + 1, kFrameHeaderSize - 1 + len);
+            if (mReceivedCrc != mComputedCrc) {
+                mSkipped++;
+                Consume(1);
+                return kCRCError;
+            }
+
+            mFrame.type = mBuf[1];
+            mFrame.seq = GetU16(mBuf + 2);
+            mFrame.len = static_cast<uint8_t>(len);
+            memcpy(mFrame.payload, mBuf + kFrameHeaderSize, len);
+            Consume(total);
+            return kFrameReady;
+        }
+    }
+
+    const Frame& frame() const { return mFrame; }
+    uint16_t receivedCrc() const { return mReceivedCrc; }
+    uint16_t computedCrc() const { return mComputedCrc; }
+
+    // 取出并清零同步过程中丢弃的字节数
+    uint32_t TakeSkipped() { uint32_t n = mSkipped; mSkipped = 0; return n; }
+
+private:
+    void Consume(size_t n) {
+        if (n == 0) return;
+        mLen -= n;
+        memmove(mBuf, mBuf + n, mLen);
+    }
+
+    uint8_t mBuf[kFrameMaxSize];
+    size_t mLen = 0;
+    Frame mFrame = {};
+    uint16_t mReceivedCrc = 0;
+    uint16_t mComputedCrc = 0;
+    uint32_t mSkipped = 0;
+};
+
+} // namespace fcu
@@ -4,6 +4,7 @@
 #include "XPLMProcessing.h"
 #include "XPLMUtilities.h"
 #include "XPLMMenus.h"
+#include "XPLMPlugin.h"
 
 #include <string>
 #include <sstream>
@@ -12,17 +13,40 @@
 #include <cstdlib>
 #include <cmath>
 #include <vector>
+#include <cstdint>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <deque>
 
 #ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX  // windows.h 的 min/max 宏会破坏 std::min/std::max
+#endif
 #include <windows.h>
+#include <setupapi.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <dirent.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
 #endif
 
+#include "fcu_protocol.h"
+
 // 在macOS上消除OpenGL弃用警告
 #if !defined(IBM) && !defined(LIN)
 #define GL_SILENCE_DEPRECATION
 #endif
 
 #if IBM
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <windows.h>
 #include <GL/gl.h>
 #elif LIN
@@ -49,18 +73,555 @@ XPLMDataRef gSPDmanaged = nullptr;  // 0=手动, 1=自动
 XPLMDataRef gHDGmanaged = nullptr;  // 0=手动, 1=自动
 XPLMDataRef gAPVerticalMode = nullptr;  // 1=CLB, 101=OP CLB, 107=VS
 
+// FCU 显示字段（变化检测脏位掩码的位序号）
+enum FCUField {
+    kFieldSPD = 0,       // SPD 或 MACH（取决于 machMode）
+    kFieldHDG,
+    kFieldALT,
+    kFieldVS,
+    kFieldFPA,
+    kFieldHDGTRKMode,
+    kFieldMachMode,
+    kFieldSPDManaged,
+    kFieldHDGManaged,
+    kFieldVerticalMode,
+    kFieldAP1,
+    kFieldAP2,
+    kFieldCount
+};
+
+// 浮点字段的变化检测参数（单位与 DataRef 原始值一致）
+struct ChangeFilterConfig {
+    float quantum;     // 显示量化步长，例如 V/S 为 100 fpm，MACH 为 0.001
+    float deadband;    // 死区：原始值相对上次接受值的变化小于此值时视为噪声
+    float hysteresis;  // 迟滞：原始值需越过量化边界再超出此余量才切换到新的显示值
+    float period = 0.0f;  // 循环量的周期（HDG 为 360），0 表示非循环量
+};
+
+// 死区 + 迟滞变化检测器
+// 只有显示出来的量化值真正改变时 update() 才返回 true，
+// 避免原始值末位抖动或在量化边界附近来回跳动导致下游反复刷新
+struct ChangeFilter {
+    ChangeFilterConfig config;
+    float lastRaw = 0.0f;     // 上次通过死区的原始值
+    long committedSteps = 0;  // 当前显示值 = committedSteps * quantum
+    bool initialized = false;
+
+    float value() const { return committedSteps * config.quantum; }
+
+    void reset() { initialized = false; }
+
+    // 循环量取最短方向的差值（359.9 与 0.1 相差 0.2）
+    float distance(float a, float b) const {
+        float d = a - b;
+        return std::fabs(config.period > 0.0f ? std::remainder(d, config.period) : d);
+    }
+
+    // 量化为步数，循环量折回 [0, period)，例如 HDG 359.5 显示为 000 而不是 360
+    long quantize(float raw) const {
+        long steps = std::lround(raw / config.quantum);
+        if (config.period > 0.0f) {
+            long periodSteps = std::lround(config.period / config.quantum);
+            steps = ((steps % periodSteps) + periodSteps) % periodSteps;
+        }
+        return steps;
+    }
+
+    bool update(float raw) {
+        if (!initialized) {
+            lastRaw = raw;
+            committedSteps = quantize(raw);
+            initialized = true;
+            return true;
+        }
+
+        // 死区：过滤末位噪声
+        if (distance(raw, lastRaw) < config.deadband) {
+            return false;
+        }
+        lastRaw = raw;
+
+        // 迟滞：必须越过当前量化区间的边界并超出迟滞余量
+        if (distance(raw, value()) < config.quantum * 0.5f + config.hysteresis) {
+            return false;
+        }
+
+        long steps = quantize(raw);
+        if (steps == committedSteps) {
+            return false;
+        }
+        committedSteps = steps;
+        return true;
+    }
+};
+
+// 各浮点字段的检测参数，可按需调整
+ChangeFilter gSPDFilter  = {{1.0f,    0.05f,   0.25f}};    // 1 kt
+ChangeFilter gMachFilter = {{0.001f,  0.0001f, 0.0003f}};  // 3 位小数
+ChangeFilter gHDGFilter  = {{1.0f,    0.05f,   0.25f, 360.0f}};  // 1 deg，000-359
+ChangeFilter gALTFilter  = {{1.0f,    0.5f,    0.0f}};     // 1 ft
+ChangeFilter gVSFilter   = {{100.0f,  1.0f,    15.0f}};    // 100 fpm
+ChangeFilter gFPAFilter  = {{0.1f,    0.005f,  0.02f}};    // 0.1 deg
+
+// 一次采样得到的 FCU 显示状态（浮点值均已按显示精度量化）
+struct FCUSnapshot {
+    float spd = 0.0f;  // kts 或 MACH
+    float hdg = 0.0f;
+    float alt = 0.0f;
+    float vs  = 0.0f;
+    float fpa = 0.0f;
+    int hdgTrkMode = 0;
+    int machMode = 0;
+    int spdManaged = 0;
+    int hdgManaged = 0;
+    int apVerticalMode = 0;
+    int ap1 = 0;
+    int ap2 = 0;
+
+    uint32_t dirty = 0;     // 本次采样中变化的字段 (1u << FCUField)
+    uint32_t sequence = 0;  // 每次 dirty != 0 时递增，下游据此判断是否需要重新处理
+};
+
+FCUSnapshot gFCUSnapshot;
+
+// 窗口中的 FCU 文本行，每行只依赖部分字段
+enum FCUTextLine {
+    kLineTitle = 0,
+    kLineSPD,
+    kLineHDG,
+    kLineALT,
+    kLineVS,
+    kLineSeparator,
+    kLineMode,
+    kLineAP,
+    kLineFooter,
+    kLineCount
+};
+
+// 各行依赖的字段，快照 dirty 与之相交时才重新格式化该行
+const uint32_t kLineFields[kLineCount] = {
+    0,
+    (1u << kFieldSPD) | (1u << kFieldSPDManaged) | (1u << kFieldMachMode),
+    (1u << kFieldHDG) | (1u << kFieldHDGManaged) | (1u << kFieldHDGTRKMode),
+    (1u << kFieldALT) | (1u << kFieldVerticalMode),
+    (1u << kFieldVS) | (1u << kFieldFPA) | (1u << kFieldVerticalMode) | (1u << kFieldHDGTRKMode),
+    0,
+    (1u << kFieldHDGTRKMode) | (1u << kFieldMachMode),
+    (1u << kFieldAP1) | (1u << kFieldAP2),
+    0,
+};
+
+// 下游缓存：按快照 dirty 只重新格式化变化的行
+std::string gFCULines[kLineCount];
+uint32_t gFCULinesSequence = 0;
+bool gFCULinesValid = false;
+
+// 诊断事件类型
+enum DiagEventType : uint8_t {
+    kEventPortOpened = 0,
+    kEventPortOpenFailed,   // code = 系统错误码, arg = OpenStage
+    kEventPortClosed,       // code = 读写出错导致断开时的系统错误码，主动关闭为 0
+    kEventPortsScanned,     // arg = 找到的端口数
+    kEventNoPortSelected,
+    kEventReconnect,        // 启动或断开后重新连接上次的设备
+    kEventFrameCRCError,    // code = 收到的 CRC, arg = 计算的 CRC
+    kEventQueueOverflow,    // arg = 丢弃的事件数
+    kEventHistoryExported,  // arg = 导出的行数
+    kEventHistoryExportFailed
+};
+
+// 打开串口失败时所处的步骤
+enum OpenStage : int32_t {
+    kStageCreateFile = 0,
+    kStageGetCommState,
+    kStageSetCommState,
+    kStageSetTimeouts
+};
+
+// 诊断事件：固定大小、可平凡复制，文本在 UI 线程显示时才格式化
+struct DiagEvent {
+    uint32_t timeMs;    // 插件启动以来的毫秒数
+    uint8_t type;       // DiagEventType
+    int32_t code;
+    int32_t arg;
+    char port[32];
+};
+
+// 有界多生产者无锁事件环（基于每个槽位的序号，单消费者）
+// 任意线程都可以 Push；队列满时丢弃新事件并计数，由消费者补一条溢出事件
+class DiagEventRing {
+public:
+    static const uint32_t kCapacity = 256;  // 必须是 2 的幂
+
+    DiagEventRing() {
+        for (uint32_t i = 0; i < kCapacity; i++) {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool Push(const DiagEvent& event) {
+        uint32_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &mCells[pos & (kCapacity - 1)];
+            uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+            int32_t diff = static_cast<int32_t>(seq - pos);
+            if (diff == 0) {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;  // 队列已满
+            } else {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->event = event;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 仅由主线程调用
+    bool Pop(DiagEvent& event) {
+        Cell* cell = &mCells[mDequeuePos & (kCapacity - 1)];
+        uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (seq != mDequeuePos + 1) {
+            return false;  // 队列为空或生产者尚未写完
+        }
+        event = cell->event;
+        cell->sequence.store(mDequeuePos + kCapacity, std::memory_order_release);
+        mDequeuePos++;
+        return true;
+    }
+
+    uint32_t TakeDropped() { return mDropped.exchange(0, std::memory_order_relaxed); }
+
+private:
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        DiagEvent event;
+    };
+
+    Cell mCells[kCapacity];
+    alignas(64) std::atomic<uint32_t> mEnqueuePos{0};
+    alignas(64) std::atomic<uint32_t> mDropped{0};
+    alignas(64) uint32_t mDequeuePos = 0;
+};
+
+DiagEventRing gEventRing;
+std::chrono::steady_clock::time_point gEventEpoch = std::chrono::steady_clock::now();
+
+// 主线程保存的最近事件（供窗口滚动显示）
+const size_t kEventHistorySize = 128;
+std::deque<std::string> gEventHistory;  // 已格式化的事件文本，绘制时直接使用
+int gEventScroll = 0;  // 向上滚动的行数，0 表示显示最新事件
+
+// 记录一条诊断事件（线程安全）
+DiagEvent MakeEvent(DiagEventType type, const std::string& port, int32_t code, int32_t arg)
+{
+    DiagEvent event = {};
+    event.timeMs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - gEventEpoch).count());
+    event.type = type;
+    event.code = code;
+    event.arg = arg;
+    strncpy(event.port, port.c_str(), sizeof(event.port) - 1);
+    return event;
+}
+
+void PostEvent(DiagEventType type, const std::string& port = "", int32_t code = 0, int32_t arg = 0)
+{
+    gEventRing.Push(MakeEvent(type, port, code, arg));
+}
+
+// 格式化事件文本（只在显示或写日志时调用）
+std::string FormatEvent(const DiagEvent& event)
+{
+    static const char* kStageNames[] = {"open", "get comm state", "set comm state", "set timeouts"};
+
+    std::ostringstream oss;
+    oss << "[" << std::setw(7) << std::fixed << std::setprecision(1) << event.timeMs / 1000.0 << "] ";
+    switch (event.type) {
+        case kEventPortOpened:
+            oss << event.port << " opened";
+            break;
+        case kEventPortOpenFailed:
+            oss << event.port << " failed to "
+                << (event.arg >= kStageCreateFile && event.arg <= kStageSetTimeouts ? kStageNames[event.arg] : "open")
+                << " (error " << event.code << ")";
+            break;
+        case kEventPortClosed:
+            oss << event.port << " closed";
+            if (event.code != 0) {
+                oss << " (link lost, error " << event.code << ")";
+            }
+            break;
+        case kEventPortsScanned:
+            if (event.arg == 0) {
+                oss << "No serial ports found";
+            } else {
+                oss << event.arg << " port(s) found";
+            }
+            break;
+        case kEventNoPortSelected:
+            oss << "No port selected";
+            break;
+        case kEventReconnect:
+            oss << "Reconnecting to " << event.port;
+            break;
+        case kEventFrameCRCError:
+            oss << event.port << " CRC error (got " << std::hex << std::setw(4) << std::setfill('0') << event.code
+                << ", expected " << std::setw(4) << event.arg << ")";
+            break;
+        case kEventQueueOverflow:
+            oss << event.arg << " event(s) dropped";
+            break;
+        case kEventHistoryExported:
+            oss << "History exported (" << event.arg << " rows)";
+            break;
+        case kEventHistoryExportFailed:
+            oss << "History export failed";
+            break;
+        default:
+            oss << "Unknown event " << static_cast<int>(event.type);
+            break;
+    }
+    return oss.str();
+}
+
+// 取出所有新事件：放入窗口历史，并合并成一次 XPLMDebugString 写入 Log.txt
+void AppendEvent(const DiagEvent& event, std::string& batch)
+{
+    std::string text = FormatEvent(event);
+    batch += "ToLissFCUMonitor: " + text + "\n";
+
+    gEventHistory.push_back(std::move(text));
+    if (gEventHistory.size() > kEventHistorySize) {
+        gEventHistory.pop_front();
+    }
+    // 正在查看旧事件时保持视图不动
+    if (gEventScroll > 0) {
+        gEventScroll++;
+    }
+}
+
+void DrainEvents()
+{
+    std::string batch;
+    DiagEvent event;
+    while (gEventRing.Pop(event)) {
+        AppendEvent(event, batch);
+    }
+
+    // 溢出事件不经过队列（此时队列可能仍是满的），直接追加在本批之后
+    uint32_t dropped = gEventRing.TakeDropped();
+    if (dropped > 0) {
+        AppendEvent(MakeEvent(kEventQueueOverflow, "", 0, static_cast<int32_t>(dropped)), batch);
+    }
+
+    if (!batch.empty()) {
+        XPLMDebugString(batch.c_str());
+    }
+}
+
+float DrainEventsCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop,
+                          int inCounter, void* inRefcon)
+{
+    DrainEvents();
+    return 0.25f;
+}
+
+// FCU 目标值历史通道
+enum HistoryChannel {
+    kHistALT = 0,
+    kHistSPD,           // kts，MACH 模式下无值
+    kHistMach,          // MACH，SPD 模式下无值
+    kHistVS,
+    kHistVerticalMode,
+    kHistChannelCount
+};
+
+const char* kHistoryChannelNames[kHistChannelCount] = {"ALT", "SPD", "MACH", "V/S", "VMODE"};
+
+// 一个分辨率层的环形缓冲，按通道分列存储 (SoA)，容量固定
+// 每个样本保存该时间段内的最后值和最小/最大值，下采样时不丢失短暂的变化
+// 通道在该时间段内没有值时为 NaN（例如 MACH 模式下的 SPD），min/max 用 fmin/fmax 忽略 NaN
+struct HistoryTier {
+    static const int kCapacity = 300;
+
+    const char* name;
+    float interval;  // 每个样本代表的秒数
+    int fold;        // 多少个下层样本合并为本层一个样本（最底层为 0）
+
+    float time[kCapacity];  // 样本结束时刻（XPLMGetElapsedTime）
+    float last[kHistChannelCount][kCapacity];
+    float minv[kHistChannelCount][kCapacity];
+    float maxv[kHistChannelCount][kCapacity];
+    int head = 0;   // 下一个写入位置
+    int count = 0;
+
+    // 正在累积的样本
+    float accLast[kHistChannelCount];
+    float accMin[kHistChannelCount];
+    float accMax[kHistChannelCount];
+    int accCount = 0;
+
+    HistoryTier(const char* inName, float inInterval, int inFold)
+        : name(inName), interval(inInterval), fold(inFold) {}
+
+    void Accumulate(const float* inLast, const float* inMin, const float* inMax) {
+        for (int c = 0; c < kHistChannelCount; c++) {
+            accLast[c] = (accCount && std::isnan(inLast[c])) ? accLast[c] : inLast[c];
+            accMin[c] = accCount ? std::fmin(accMin[c], inMin[c]) : inMin[c];
+            accMax[c] = accCount ? std::fmax(accMax[c], inMax[c]) : inMax[c];
+        }
+        accCount++;
+    }
+
+    void Commit(float now) {
+        if (accCount == 0) return;
+        time[head] = now;
+        for (int c = 0; c < kHistChannelCount; c++) {
+            last[c][head] = accLast[c];
+            minv[c][head] = accMin[c];
+            maxv[c][head] = accMax[c];
+        }
+        head = (head + 1) % kCapacity;
+        if (count < kCapacity) count++;
+        accCount = 0;
+    }
+
+    // 第 i 个样本的存储位置，i = 0 为最旧
+    int Index(int i) const { return (head - count + i + kCapacity) % kCapacity; }
+
+    // 最新样本的存储位置
+    int Newest() const { return (head - 1 + kCapacity) % kCapacity; }
+};
+
+// 1 秒 / 10 秒 / 60 秒三层，每层 300 个样本（5 分钟 / 50 分钟 / 5 小时）
+const int kHistoryTierCount = 3;
+HistoryTier gHistoryTiers[kHistoryTierCount] = {
+    HistoryTier("1s", 1.0f, 0),
+    HistoryTier("10s", 10.0f, 10),
+    HistoryTier("60s", 60.0f, 6),
+};
+
+float gHistoryNextTick = 0.0f;
+bool gShowHistory = false;   // 窗口中显示走势图而不是事件日志
+int gHistoryViewTier = 0;    // 走势图当前显示的层
+
+// 把当前快照计入历史（每帧调用），每满 1 秒提交一个样本并逐层下采样
+void RecordHistory(float now)
+{
+    float values[kHistChannelCount];
+    values[kHistALT] = gFCUSnapshot.alt;
+    values[kHistSPD] = gFCUSnapshot.machMode ? NAN : gFCUSnapshot.spd;
+    values[kHistMach] = gFCUSnapshot.machMode ? gFCUSnapshot.spd : NAN;
+    values[kHistVS] = gFCUSnapshot.vs;
+    values[kHistVerticalMode] = static_cast<float>(gFCUSnapshot.apVerticalMode);
+
+    gHistoryTiers[0].Accumulate(values, values, values);
+    if (now < gHistoryNextTick) return;
+
+    // 长时间没有调用（例如加载场景）时不补齐中间的样本
+    gHistoryNextTick = (now - gHistoryNextTick > 1.0f) ? now + 1.0f : gHistoryNextTick + 1.0f;
+    gHistoryTiers[0].Commit(now);
+
+    for (int k = 1; k < kHistoryTierCount; k++) {
+        HistoryTier& lower = gHistoryTiers[k - 1];
+        HistoryTier& tier = gHistoryTiers[k];
+        int n = lower.Newest();
+
+        float lastValues[kHistChannelCount], minValues[kHistChannelCount], maxValues[kHistChannelCount];
+        for (int c = 0; c < kHistChannelCount; c++) {
+            lastValues[c] = lower.last[c][n];
+            minValues[c] = lower.minv[c][n];
+            maxValues[c] = lower.maxv[c][n];
+        }
+        tier.Accumulate(lastValues, minValues, maxValues);
+        if (tier.accCount < tier.fold) break;  // 上层还没有凑满，更高层也不会变化
+        tier.Commit(now);
+    }
+}
+
+// 导出所有层的历史到 <X-Plane>/Output/ToLissFCUMonitor_history.csv
+void ExportHistoryCSV()
+{
+    char systemPath[512] = {0};
+    XPLMGetSystemPath(systemPath);
+    std::string path = std::string(systemPath) + "Output" + XPLMGetDirectorySeparator() + "ToLissFCUMonitor_history.csv";
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        PostEvent(kEventHistoryExportFailed);
+        return;
+    }
+
+    out << "tier,time_s";
+    for (int c = 0; c < kHistChannelCount; c++) {
+        out << "," << kHistoryChannelNames[c] << "," << kHistoryChannelNames[c] << "_min,"
+            << kHistoryChannelNames[c] << "_max";
+    }
+    out << "\n";
+
+    int rows = 0;
+    for (const HistoryTier& tier : gHistoryTiers) {
+        for (int i = 0; i < tier.count; i++) {
+            int idx = tier.Index(i);
+            out << tier.name << "," << tier.time[idx];
+            for (int c = 0; c < kHistChannelCount; c++) {
+                // 没有值的通道（如 MACH 模式下的 SPD）留空
+                for (float value : {tier.last[c][idx], tier.minv[c][idx], tier.maxv[c][idx]}) {
+                    out << ",";
+                    if (!std::isnan(value)) out << value;
+                }
+            }
+            out << "\n";
+            rows++;
+        }
+    }
+    PostEvent(kEventHistoryExported, "", 0, rows);
+}
+
 XPLMWindowID gWindow = nullptr;
 XPLMMenuID gMenuID = nullptr;
 int gMenuItemIdx = -1;
 XPLMMenuID gPortMenuID = nullptr;
 int gPortMenuItemIdx = -1;
 
+// 插件设置（窗口位置和上次成功连接的设备），保存在 X-Plane 的 preferences 目录
+struct PluginPrefs {
+    int windowLeft = 50;
+    int windowTop = 600;
+    int windowRight = 380;
+    int windowBottom = 200;  // 调整高度以容纳串口信息、事件日志和UI控件
+    std::string deviceId;    // 上次成功连接设备的实例 ID（不随 COM 编号变化）
+    std::string portName;    // 上次成功连接的端口名，仅在没有设备 ID 时使用
+};
+
+PluginPrefs gPrefs;
+
 // 串口相关
 #ifdef _WIN32
-HANDLE gSerialHandle = INVALID_HANDLE_VALUE;
+// 以重叠 I/O 方式打开的串口，读写都不在模拟线程中等待
+struct WinSerialPort {
+    HANDLE handle;
+    OVERLAPPED readOverlapped;
+    OVERLAPPED writeOverlapped;
+    bool readPending;
+    bool writePending;
+    uint8_t readBuffer[1024];
+    std::vector<uint8_t> writeBuffer;  // 写入完成前必须保持有效
+};
+typedef WinSerialPort* SerialHandle;
+const SerialHandle kInvalidSerialHandle = nullptr;
+#else
+typedef int SerialHandle;  // 文件描述符
+const SerialHandle kInvalidSerialHandle = -1;
 #endif
+SerialHandle gSerialHandle = kInvalidSerialHandle;
 std::string gSerialPortName = "";
-std::string gSerialStatus = "Disconnected";
 std::vector<std::string> gAvailablePorts;
 std::vector<std::string> gPortMenuRefs; // 保存菜单项引用字符串
 
@@ -68,15 +629,130 @@ std::vector<std::string> gPortMenuRefs; // 保存菜单项引用字符串
 int gSelectedPortIndex = 0;  // 当前选择的串口索引
 bool gShowDropdown = false;  // 是否显示下拉列表
 
+// 设置文件路径：<X-Plane>/Output/preferences/ToLissFCUMonitor.prf
+std::string GetPrefsFilePath()
+{
+    char prefsPath[512] = {0};
+    XPLMGetPrefsPath(prefsPath);
+    std::string path = prefsPath;
+    size_t sep = path.find_last_of("/\\:");
+    path = (sep == std::string::npos) ? "" : path.substr(0, sep + 1);
+    return path + "ToLissFCUMonitor.prf";
+}
+
+void LoadPrefs()
+{
+    std::ifstream in(GetPrefsFilePath());
+    if (!in) return;  // 首次运行，使用默认值
+
+    PluginPrefs prefs;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+
+        std::string key = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        if (key == "window_left")        prefs.windowLeft = atoi(value.c_str());
+        else if (key == "window_top")    prefs.windowTop = atoi(value.c_str());
+        else if (key == "window_right")  prefs.windowRight = atoi(value.c_str());
+        else if (key == "window_bottom") prefs.windowBottom = atoi(value.c_str());
+        else if (key == "device_id")     prefs.deviceId = value;
+        else if (key == "port")          prefs.portName = value;
+    }
+
+    // 窗口尺寸异常时保留默认位置
+    if (prefs.windowRight <= prefs.windowLeft || prefs.windowTop <= prefs.windowBottom) {
+        PluginPrefs defaults;
+        prefs.windowLeft = defaults.windowLeft;
+        prefs.windowTop = defaults.windowTop;
+        prefs.windowRight = defaults.windowRight;
+        prefs.windowBottom = defaults.windowBottom;
+    }
+    gPrefs = prefs;
+}
+
+void SavePrefs()
+{
+    // 记录窗口当前位置
+    if (gWindow) {
+        XPLMGetWindowGeometry(gWindow, &gPrefs.windowLeft, &gPrefs.windowTop,
+                              &gPrefs.windowRight, &gPrefs.windowBottom);
+    }
+
+    std::ofstream out(GetPrefsFilePath(), std::ios::trunc);
+    if (!out) {
+        XPLMDebugString("ToLissFCUMonitor: failed to save preferences\n");
+        return;
+    }
+    out << "window_left=" << gPrefs.windowLeft << "\n";
+    out << "window_top=" << gPrefs.windowTop << "\n";
+    out << "window_right=" << gPrefs.windowRight << "\n";
+    out << "window_bottom=" << gPrefs.windowBottom << "\n";
+    out << "device_id=" << gPrefs.deviceId << "\n";
+    out << "port=" << gPrefs.portName << "\n";
+}
+
 // 串口函数
+struct PortDevice {
+    std::string portName;  // Windows: COMx，其他平台: 设备路径
+    std::string deviceId;  // 稳定的设备 ID，不随端口编号变化
+};
+
 #ifdef _WIN32
-std::vector<std::string> EnumerateSerialPorts()
+// 端口设备类 GUID_DEVCLASS_PORTS
+const GUID kPortsClassGuid = {0x4d36e978, 0xe325, 0x11ce, {0xbf, 0xc1, 0x08, 0x00, 0x2b, 0xe1, 0x03, 0x18}};
+
+// 通过 SetupAPI 列出系统中的串口设备（只读注册表，不打开端口）
+// 设备 ID 为设备实例 ID，例如 USB\VID_0483&PID_5740\xxxx
+bool EnumeratePortDevices(std::vector<PortDevice>& devices)
+{
+    devices.clear();
+    HDEVINFO devInfo = SetupDiGetClassDevsA(&kPortsClassGuid, nullptr, nullptr, DIGCF_PRESENT);
+    if (devInfo == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    SP_DEVINFO_DATA devData;
+    devData.cbSize = sizeof(devData);
+    for (DWORD i = 0; SetupDiEnumDeviceInfo(devInfo, i, &devData); i++) {
+        HKEY key = SetupDiOpenDevRegKey(devInfo, &devData, DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ);
+        if (key == reinterpret_cast<HKEY>(INVALID_HANDLE_VALUE)) continue;
+
+        char portName[32] = {0};
+        DWORD size = sizeof(portName) - 1;
+        DWORD type = 0;
+        LONG result = RegQueryValueExA(key, "PortName", nullptr, &type,
+                                       reinterpret_cast<LPBYTE>(portName), &size);
+        RegCloseKey(key);
+
+        // 同一设备类里还有 LPT 并口，只保留 COM
+        if (result != ERROR_SUCCESS || type != REG_SZ || strncmp(portName, "COM", 3) != 0) continue;
+
+        char instanceId[256] = {0};
+        if (!SetupDiGetDeviceInstanceIdA(devInfo, &devData, instanceId, sizeof(instanceId), nullptr)) continue;
+
+        devices.push_back({portName, instanceId});
+    }
+    SetupDiDestroyDeviceInfoList(devInfo);
+
+    // 按 COM 编号排序
+    std::sort(devices.begin(), devices.end(), [](const PortDevice& a, const PortDevice& b) {
+        return atoi(a.portName.c_str() + 3) < atoi(b.portName.c_str() + 3);
+    });
+    return true;
+}
+
+// 逐个尝试打开 COM1~COM256（SetupAPI 不可用时的回退方案，较慢）
+std::vector<std::string> ProbeSerialPorts()
 {
     std::vector<std::string> ports;
     for (int i = 1; i <= 256; i++) {
         std::string portName = "COM" + std::to_string(i);
+        std::string devicePath = "\\\\.\\" + portName;
         HANDLE hSerial = CreateFileA(
-            portName.c_str(),
+            devicePath.c_str(),
             GENERIC_READ | GENERIC_WRITE,
             0,
             nullptr,
@@ -93,38 +769,35 @@ std::vector<std::string> EnumerateSerialPorts()
     return ports;
 }
 
-bool OpenSerialPort(const std::string& portName)
+// 打开并配置串口，失败时返回 kInvalidSerialHandle 并记录失败事件
+// 除事件环外不访问任何全局状态，可在后台线程调用
+SerialHandle OpenConfiguredPort(const std::string& portName)
 {
-    if (gSerialHandle != INVALID_HANDLE_VALUE) {
-        CloseHandle(gSerialHandle);
-        gSerialHandle = INVALID_HANDLE_VALUE;
-    }
-
-    gSerialHandle = CreateFileA(
-        portName.c_str(),
+    // COM10 及以上必须使用 \\.\COMxx 形式
+    std::string devicePath = "\\\\.\\" + portName;
+    HANDLE handle = CreateFileA(
+        devicePath.c_str(),
         GENERIC_READ | GENERIC_WRITE,
         0,
         nullptr,
         OPEN_EXISTING,
-        0,
+        FILE_FLAG_OVERLAPPED,
         nullptr
     );
 
-    if (gSerialHandle == INVALID_HANDLE_VALUE) {
-        gSerialStatus = "Failed to open " + portName;
-        gSerialPortName = "";
-        return false;
+    if (handle == INVALID_HANDLE_VALUE) {
+        PostEvent(kEventPortOpenFailed, portName, static_cast<int32_t>(GetLastError()), kStageCreateFile);
+        return kInvalidSerialHandle;
     }
 
     // 配置串口参数
     DCB dcbSerialParams = {0};
     dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
 
-    if (!GetCommState(gSerialHandle, &dcbSerialParams)) {
-        CloseHandle(gSerialHandle);
-        gSerialHandle = INVALID_HANDLE_VALUE;
-        gSerialStatus = "Failed to get comm state";
-        return false;
+    if (!GetCommState(handle, &dcbSerialParams)) {
+        PostEvent(kEventPortOpenFailed, portName, static_cast<int32_t>(GetLastError()), kStageGetCommState);
+        CloseHandle(handle);
+        return kInvalidSerialHandle;
     }
 
     dcbSerialParams.BaudRate = CBR_115200; // 115200 波特率
@@ -132,69 +805,677 @@ bool OpenSerialPort(const std::string& portName)
     dcbSerialParams.StopBits = ONESTOPBIT;
     dcbSerialParams.Parity = NOPARITY;
 
-    if (!SetCommState(gSerialHandle, &dcbSerialParams)) {
-        CloseHandle(gSerialHandle);
-        gSerialHandle = INVALID_HANDLE_VALUE;
-        gSerialStatus = "Failed to set comm state";
-        return false;
+    if (!SetCommState(handle, &dcbSerialParams)) {
+        PostEvent(kEventPortOpenFailed, portName, static_cast<int32_t>(GetLastError()), kStageSetCommState);
+        CloseHandle(handle);
+        return kInvalidSerialHandle;
     }
 
-    // 设置超时参数
+    // 设置超时参数：读取立即返回已到达的数据；写入不设超时，
+    // 对端不接收时写操作一直挂起，但模拟线程只检查是否完成，不会等待
     COMMTIMEOUTS timeouts = {0};
-    timeouts.ReadIntervalTimeout = 50;
-    timeouts.ReadTotalTimeoutConstant = 50;
-    timeouts.ReadTotalTimeoutMultiplier = 10;
-    timeouts.WriteTotalTimeoutConstant = 50;
-    timeouts.WriteTotalTimeoutMultiplier = 10;
-    
-    if (!SetCommTimeouts(gSerialHandle, &timeouts)) {
-        CloseHandle(gSerialHandle);
-        gSerialHandle = INVALID_HANDLE_VALUE;
-        gSerialStatus = "Failed to set timeouts";
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = 0;
+    timeouts.ReadTotalTimeoutMultiplier = 0;
+    timeouts.WriteTotalTimeoutConstant = 0;
+    timeouts.WriteTotalTimeoutMultiplier = 0;
+
+    if (!SetCommTimeouts(handle, &timeouts)) {
+        PostEvent(kEventPortOpenFailed, portName, static_cast<int32_t>(GetLastError()), kStageSetTimeouts);
+        CloseHandle(handle);
+        return kInvalidSerialHandle;
+    }
+
+    WinSerialPort* port = new WinSerialPort();
+    port->handle = handle;
+    port->readOverlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    port->writeOverlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+    PostEvent(kEventPortOpened, portName);
+    return port;
+}
+
+void CloseSerialHandle(SerialHandle port)
+{
+    // 取消未完成的读写，并等待取消完成后再释放缓冲区
+    CancelIoEx(port->handle, nullptr);
+    DWORD ignored = 0;
+    if (port->readPending) GetOverlappedResult(port->handle, &port->readOverlapped, &ignored, TRUE);
+    if (port->writePending) GetOverlappedResult(port->handle, &port->writeOverlapped, &ignored, TRUE);
+
+    CloseHandle(port->readOverlapped.hEvent);
+    CloseHandle(port->writeOverlapped.hEvent);
+    CloseHandle(port->handle);
+    delete port;
+}
+
+// 读取已到达的数据，返回字节数（最多 size 字节）；连接断开时返回 -1
+// 读操作尚未完成时返回 0，下次调用再检查
+int ReadSerial(SerialHandle port, uint8_t* buffer, int size)
+{
+    if (!port->readPending) {
+        DWORD request = std::min(static_cast<DWORD>(size), static_cast<DWORD>(sizeof(port->readBuffer)));
+        ResetEvent(port->readOverlapped.hEvent);
+        if (!ReadFile(port->handle, port->readBuffer, request, nullptr, &port->readOverlapped) &&
+            GetLastError() != ERROR_IO_PENDING) {
+            return -1;
+        }
+        port->readPending = true;
+    }
+
+    DWORD bytesRead = 0;
+    if (!GetOverlappedResult(port->handle, &port->readOverlapped, &bytesRead, FALSE)) {
+        return GetLastError() == ERROR_IO_INCOMPLETE ? 0 : -1;
+    }
+    port->readPending = false;
+
+    // 挂起的读操作可能是以更大的 size 发起的，多出的部分无处存放，调用方应始终使用相同的缓冲区大小
+    int count = std::min(static_cast<int>(bytesRead), size);
+    memcpy(buffer, port->readBuffer, count);
+    return count;
+}
+
+// 提交数据写入，返回被接收的字节数；上一次写入还未完成时返回 0，连接断开时返回 -1
+// 写入在后台完成，不等待
+int WriteSerial(SerialHandle port, const uint8_t* data, int size)
+{
+    if (port->writePending) {
+        DWORD bytesWritten = 0;
+        if (!GetOverlappedResult(port->handle, &port->writeOverlapped, &bytesWritten, FALSE)) {
+            return GetLastError() == ERROR_IO_INCOMPLETE ? 0 : -1;
+        }
+        port->writePending = false;
+    }
+
+    port->writeBuffer.assign(data, data + size);
+    ResetEvent(port->writeOverlapped.hEvent);
+    if (!WriteFile(port->handle, port->writeBuffer.data(), static_cast<DWORD>(size), nullptr, &port->writeOverlapped)) {
+        if (GetLastError() != ERROR_IO_PENDING) return -1;
+    }
+    port->writePending = true;
+    return size;
+}
+
+int LastSerialError()
+{
+    return static_cast<int>(GetLastError());
+}
+#else
+// 加入一个端口，同一设备路径只保留第一次出现的（优先使用稳定 ID）
+void AddPortDevice(std::vector<PortDevice>& devices, const std::string& portName, const std::string& deviceId)
+{
+    for (const auto& device : devices) {
+        if (device.portName == portName) return;
+    }
+    devices.push_back({portName, deviceId});
+}
+
+// 列出目录中以指定前缀开头的条目
+std::vector<std::string> ListDirectory(const char* path, const std::vector<const char*>& prefixes)
+{
+    std::vector<std::string> names;
+    DIR* dir = opendir(path);
+    if (!dir) return names;
+
+    while (dirent* entry = readdir(dir)) {
+        for (const char* prefix : prefixes) {
+            if (strncmp(entry->d_name, prefix, strlen(prefix)) == 0) {
+                names.push_back(entry->d_name);
+                break;
+            }
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+// 列出串口设备（只读目录，不打开端口）
+// - 环境变量 FCU_SERIAL_PORT 指定的端口，例如 fcu_emulator --link 创建的 PTY 链接
+// - Linux: /dev/serial/by-id 下的链接名作为稳定 ID
+// - 其余 /dev/ttyUSB*、/dev/ttyACM*（Linux）和 /dev/cu.usb*（macOS），以路径作为 ID
+bool EnumeratePortDevices(std::vector<PortDevice>& devices)
+{
+    devices.clear();
+
+    const char* extraPort = getenv("FCU_SERIAL_PORT");
+    if (extraPort && *extraPort && access(extraPort, F_OK) == 0) {
+        AddPortDevice(devices, extraPort, extraPort);
+    }
+
+    for (const auto& name : ListDirectory("/dev/serial/by-id", {""})) {
+        if (name[0] == '.') continue;
+        std::string linkPath = "/dev/serial/by-id/" + name;
+        char target[PATH_MAX] = {0};
+        if (realpath(linkPath.c_str(), target)) {
+            AddPortDevice(devices, target, name);
+        }
+    }
+
+    for (const auto& name : ListDirectory("/dev", {"ttyUSB", "ttyACM", "cu.usbmodem", "cu.usbserial"})) {
+        AddPortDevice(devices, "/dev/" + name, "/dev/" + name);
+    }
+    return true;
+}
+
+SerialHandle OpenConfiguredPort(const std::string& portName)
+{
+    int fd = open(portName.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        PostEvent(kEventPortOpenFailed, portName, errno, kStageCreateFile);
+        return kInvalidSerialHandle;
+    }
+
+    termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        PostEvent(kEventPortOpenFailed, portName, errno, kStageGetCommState);
+        close(fd);
+        return kInvalidSerialHandle;
+    }
+
+    // 115200 8N1，原始模式；O_NONBLOCK 使读写立即返回
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, B115200);
+    cfsetospeed(&tty, B115200);
+    tty.c_cflag |= CLOCAL | CREAD;
+
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        PostEvent(kEventPortOpenFailed, portName, errno, kStageSetCommState);
+        close(fd);
+        return kInvalidSerialHandle;
+    }
+
+    PostEvent(kEventPortOpened, portName);
+    return fd;
+}
+
+void CloseSerialHandle(SerialHandle handle)
+{
+    close(handle);
+}
+
+int ReadSerial(SerialHandle handle, uint8_t* buffer, int size)
+{
+    ssize_t n = read(handle, buffer, static_cast<size_t>(size));
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    if (n == 0) {
+        errno = EIO;  // 对端挂断
+        return -1;
+    }
+    return static_cast<int>(n);
+}
+
+int WriteSerial(SerialHandle handle, const uint8_t* data, int size)
+{
+    ssize_t n = write(handle, data, static_cast<size_t>(size));
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    return static_cast<int>(n);
+}
+
+int LastSerialError()
+{
+    return errno;
+}
+#endif
+
+std::vector<std::string> EnumerateSerialPorts()
+{
+    std::vector<PortDevice> devices;
+    if (!EnumeratePortDevices(devices)) {
+#ifdef _WIN32
+        return ProbeSerialPorts();
+#endif
+    }
+
+    std::vector<std::string> ports;
+    for (const auto& device : devices) {
+        ports.push_back(device.portName);
+    }
+    return ports;
+}
+
+// 查询端口对应的设备 ID
+std::string GetPortDeviceId(const std::string& portName)
+{
+    std::vector<PortDevice> devices;
+    EnumeratePortDevices(devices);
+    for (const auto& device : devices) {
+        if (device.portName == portName) return device.deviceId;
+    }
+    return "";
+}
+
+// 在设备列表中查找上次成功连接的设备当前所在的端口，设备不在时返回空字符串
+// 没有设备 ID 时按端口名查找
+std::string FindLastGoodPort(const std::vector<PortDevice>& devices, const std::string& deviceId,
+                             const std::string& portName)
+{
+    for (const auto& device : devices) {
+        if (deviceId.empty() ? device.portName == portName : device.deviceId == deviceId) {
+            return device.portName;
+        }
+    }
+    return "";
+}
+
+bool IsSerialOpen()
+{
+    return gSerialHandle != kInvalidSerialHandle;
+}
+
+// 收到面板的第一个有效帧后记住设备，下次启动直接打开
+// （只是能打开的端口，如蓝牙、调制解调器串口，不会被记住）
+void RememberConnectedDevice(const std::string& portName)
+{
+    std::string deviceId = GetPortDeviceId(portName);
+    if (deviceId == gPrefs.deviceId && portName == gPrefs.portName) return;
+
+    gPrefs.deviceId = deviceId;
+    gPrefs.portName = portName;
+    SavePrefs();
+}
+
+// 面板链路（协议见 fcu_protocol.h），在模拟线程每帧轮询
+struct PanelLinkStats {
+    uint32_t rxFrames = 0;
+    uint32_t txFrames = 0;
+    uint32_t crcErrors = 0;
+    uint32_t skippedBytes = 0;  // 重新同步时丢弃的字节
+    uint32_t txDropped = 0;     // 发送缓冲区满时丢弃的帧
+};
+
+fcu::FrameDecoder gLinkDecoder;
+PanelLinkStats gLinkStats;
+std::vector<uint8_t> gLinkTxBuffer;                 // 待发送的完整帧，写不完的部分留到下一帧
+const size_t kLinkTxBufferLimit = 4096;
+uint16_t gLinkTxSeq = 0;
+uint32_t gLinkSentSequence = 0;    // 上次发送 State 帧时的快照 sequence
+float gLinkLastStateTime = 0.0f;
+bool gLinkNeedsState = true;       // 新连接建立后立即发送一次完整状态
+bool gLinkVerified = false;        // 已收到面板的有效帧，确认对端是 FCU 面板
+bool gReconnectPending = false;    // 连接意外断开，等待设备重新出现
+float gReconnectDelay = 1.0f;      // 重连失败后的等待时间，每次失败加倍
+float gNextReconnectTime = 0.0f;
+
+const float kReconnectDelayMin = 1.0f;
+const float kReconnectDelayMax = 60.0f;
+
+// 面板控件对应的 X-Plane 命令（飞机加载后才注册，首次使用时查找）
+struct ControlCommands {
+    const char* turnUp;
+    const char* turnDown;
+    const char* push;
+    const char* pull;
+    XPLMCommandRef refs[4];
+};
+
+ControlCommands gControlCommands[fcu::kControlCount] = {
+    {"sim/autopilot/airspeed_up", "sim/autopilot/airspeed_down", "AirbusFBW/PushSPDSel", "AirbusFBW/PullSPDSel", {}},
+    {"sim/autopilot/heading_up", "sim/autopilot/heading_down", "AirbusFBW/PushHDGSel", "AirbusFBW/PullHDGSel", {}},
+    {"sim/autopilot/altitude_up", "sim/autopilot/altitude_down", "AirbusFBW/PushAltitude", "AirbusFBW/PullAltitude", {}},
+    {"sim/autopilot/vertical_speed_up", "sim/autopilot/vertical_speed_down", "AirbusFBW/PushVSSel", "AirbusFBW/PullVSSel", {}},
+    {nullptr, nullptr, "toliss_airbus/ap1_push", nullptr, {}},
+    {nullptr, nullptr, "toliss_airbus/ap2_push", nullptr, {}},
+};
+
+XPLMCommandRef FindControlCommand(int control, int which)
+{
+    ControlCommands& commands = gControlCommands[control];
+    const char* names[4] = {commands.turnUp, commands.turnDown, commands.push, commands.pull};
+    if (!commands.refs[which] && names[which]) {
+        commands.refs[which] = XPLMFindCommand(names[which]);
+    }
+    return commands.refs[which];
+}
+
+void ResetPanelLink()
+{
+    gLinkDecoder.Reset();
+    gLinkTxBuffer.clear();
+    gLinkTxSeq = 0;
+    gLinkNeedsState = true;
+    gLinkVerified = false;
+}
+
+// 发送缓冲区满时丢弃整帧（序号照常递增），面板看到的是干净的序号缺口而不是半帧
+void QueueFrame(uint8_t type, const uint8_t* payload, size_t len)
+{
+    uint8_t frame[fcu::kFrameMaxSize];
+    size_t size = fcu::EncodeFrame(type, gLinkTxSeq++, payload, len, frame);
+    if (gLinkTxBuffer.size() + size > kLinkTxBufferLimit) {
+        gLinkStats.txDropped++;
+        return;
+    }
+    gLinkTxBuffer.insert(gLinkTxBuffer.end(), frame, frame + size);
+    gLinkStats.txFrames++;
+}
+
+void QueueStateFrame()
+{
+    const FCUSnapshot& s = gFCUSnapshot;
+    fcu::StatePayload state = {};
+    state.spd1000 = static_cast<int32_t>(std::lround(s.spd * 1000.0f));
+    state.hdg = static_cast<int16_t>(std::lround(s.hdg));
+    state.alt = static_cast<int32_t>(std::lround(s.alt));
+    state.vs = static_cast<int16_t>(std::lround(s.vs));
+    state.fpa10 = static_cast<int16_t>(std::lround(s.fpa * 10.0f));
+    state.verticalMode = static_cast<uint8_t>(s.apVerticalMode);
+    state.flags = (s.hdgTrkMode ? fcu::kStateHDGTRK : 0) | (s.machMode ? fcu::kStateMach : 0) |
+                  (s.spdManaged ? fcu::kStateSPDManaged : 0) | (s.hdgManaged ? fcu::kStateHDGManaged : 0) |
+                  (s.ap1 ? fcu::kStateAP1 : 0) | (s.ap2 ? fcu::kStateAP2 : 0);
+
+    uint8_t payload[fcu::kFrameMaxPayload];
+    QueueFrame(fcu::kFrameState, payload, fcu::EncodeState(state, payload));
+}
+
+// 执行面板输入并回复确认
+void HandleInputFrame(const fcu::Frame& frame)
+{
+    fcu::InputPayload input;
+    if (!fcu::DecodeInput(frame.payload, frame.len, input) || input.control >= fcu::kControlCount) {
+        return;
+    }
+
+    if (input.action == fcu::kActionTurn) {
+        XPLMCommandRef command = FindControlCommand(input.control, input.delta > 0 ? 0 : 1);
+        int steps = abs(input.delta);
+        for (int i = 0; command && i < steps; i++) {
+            XPLMCommandOnce(command);
+        }
+    } else if (input.action == fcu::kActionPush || input.action == fcu::kActionPull) {
+        XPLMCommandRef command = FindControlCommand(input.control, input.action == fcu::kActionPush ? 2 : 3);
+        if (command) XPLMCommandOnce(command);
+    }
+
+    fcu::AckPayload ack = {frame.seq};
+    uint8_t payload[fcu::kFrameMaxPayload];
+    QueueFrame(fcu::kFrameAck, payload, fcu::EncodeAck(ack, payload));
+}
+
+// 前向声明
+void DropSerialConnection(int errorCode);
+
+// 读取并处理面板发来的帧，快照变化（或每秒心跳）时发送 State 帧
+void ServicePanelLink(float now)
+{
+    if (!IsSerialOpen()) return;
+
+    // 每帧最多处理 64 KB，防止异常数据流拖住模拟线程
+    uint8_t buffer[1024];
+    for (int total = 0; total < 64 * 1024; ) {
+        int n = ReadSerial(gSerialHandle, buffer, sizeof(buffer));
+        if (n < 0) {
+            DropSerialConnection(LastSerialError());
+            return;
+        }
+        if (n == 0) break;
+        total += n;
+
+        for (int i = 0; i < n; i++) {
+            gLinkDecoder.Put(buffer[i]);
+            fcu::FrameDecoder::Result result;
+            while ((result = gLinkDecoder.Next()) != fcu::FrameDecoder::kNeedMore) {
+                if (result == fcu::FrameDecoder::kFrameReady) {
+                    gLinkStats.rxFrames++;
+                    if (!gLinkVerified) {
+                        gLinkVerified = true;
+                        gReconnectDelay = kReconnectDelayMin;
+                        RememberConnectedDevice(gSerialPortName);
+                    }
+                    if (gLinkDecoder.frame().type == fcu::kFrameInput) {
+                        HandleInputFrame(gLinkDecoder.frame());
+                    }
+                } else {
+                    gLinkStats.crcErrors++;
+                    PostEvent(kEventFrameCRCError, gSerialPortName,
+                              gLinkDecoder.receivedCrc(), gLinkDecoder.computedCrc());
+                }
+            }
+        }
+    }
+    gLinkStats.skippedBytes += gLinkDecoder.TakeSkipped();
+
+    if (gLinkNeedsState || gLinkSentSequence != gFCUSnapshot.sequence || now - gLinkLastStateTime >= 1.0f) {
+        QueueStateFrame();
+        gLinkNeedsState = false;
+        gLinkSentSequence = gFCUSnapshot.sequence;
+        gLinkLastStateTime = now;
+    }
+
+    // 每帧合并写一次；写不完的字节保留到下一帧继续写
+    if (!gLinkTxBuffer.empty()) {
+        int written = WriteSerial(gSerialHandle, gLinkTxBuffer.data(), static_cast<int>(gLinkTxBuffer.size()));
+        if (written < 0) {
+            DropSerialConnection(LastSerialError());
+            return;
+        }
+        gLinkTxBuffer.erase(gLinkTxBuffer.begin(), gLinkTxBuffer.begin() + written);
+    }
+}
+
+float PanelLinkCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop,
+                        int inCounter, void* inRefcon)
+{
+    ServicePanelLink(XPLMGetElapsedTime());
+    return -1.0f;  // 每帧调用
+}
+
+// 后台打开串口：启动时连接上次的设备，不阻塞插件加载
+// 工作线程只写 handle 并通过事件环报告结果，done 置位后由主线程接管
+struct BackgroundOpen {
+    std::thread worker;
+    std::atomic<bool> done{false};
+    std::string portName;
+    SerialHandle handle = kInvalidSerialHandle;
+    bool found = false;               // 设备在端口列表中（可能仍然打开失败）
+    bool listed = false;              // 成功枚举了设备，ports 有效
+    std::vector<std::string> ports;   // 枚举得到的端口列表，主线程直接使用，不再重复枚举
+};
+
+BackgroundOpen gBackgroundOpen;
+
+// 在后台线程中枚举设备、查找上次的设备所在端口并打开，设备不在时不打开
+// 枚举可能较慢（SetupAPI），不放在模拟线程
+void StartBackgroundOpen(const std::string& deviceId, const std::string& lastPortName)
+{
+    gBackgroundOpen.portName = "";
+    gBackgroundOpen.handle = kInvalidSerialHandle;
+    gBackgroundOpen.found = false;
+    gBackgroundOpen.listed = false;
+    gBackgroundOpen.ports.clear();
+    gBackgroundOpen.done.store(false);
+    gBackgroundOpen.worker = std::thread([deviceId, lastPortName]() {
+        std::vector<PortDevice> devices;
+        std::string portName;
+        if (EnumeratePortDevices(devices)) {
+            gBackgroundOpen.listed = true;
+            for (const auto& device : devices) {
+                gBackgroundOpen.ports.push_back(device.portName);
+            }
+            portName = FindLastGoodPort(devices, deviceId, lastPortName);
+        } else if (deviceId.empty()) {
+            // 无法枚举设备时只能直接尝试上次的端口
+            portName = lastPortName;
+        }
+
+        gBackgroundOpen.found = !portName.empty();
+        if (!portName.empty()) {
+            PostEvent(kEventReconnect, portName);
+            gBackgroundOpen.portName = portName;
+            gBackgroundOpen.handle = OpenConfiguredPort(portName);
+        }
+        gBackgroundOpen.done.store(true, std::memory_order_release);
+    });
+}
+
+// 等待后台打开结束并丢弃结果（手动选择端口或插件停止时）
+void CancelBackgroundOpen()
+{
+    if (!gBackgroundOpen.worker.joinable()) return;
+
+    gBackgroundOpen.worker.join();
+    if (gBackgroundOpen.handle != kInvalidSerialHandle) {
+        CloseSerialHandle(gBackgroundOpen.handle);
+        gBackgroundOpen.handle = kInvalidSerialHandle;
+        PostEvent(kEventPortClosed, gBackgroundOpen.portName);
+    }
+}
+
+// 主线程检查后台打开是否完成，完成则接管串口句柄
+// 返回 true 表示仍在进行中
+bool PollBackgroundOpen()
+{
+    if (!gBackgroundOpen.worker.joinable()) return false;
+    if (!gBackgroundOpen.done.load(std::memory_order_acquire)) return true;
+
+    gBackgroundOpen.worker.join();
+    if (gBackgroundOpen.handle != kInvalidSerialHandle) {
+        gSerialHandle = gBackgroundOpen.handle;
+        gBackgroundOpen.handle = kInvalidSerialHandle;
+        gSerialPortName = gBackgroundOpen.portName;
+        gReconnectPending = false;
+        ResetPanelLink();
+    }
+    return false;
+}
+
+bool OpenSerialPort(const std::string& portName)
+{
+    CancelBackgroundOpen();
+
+    if (IsSerialOpen()) {
+        CloseSerialHandle(gSerialHandle);
+        gSerialHandle = kInvalidSerialHandle;
+    }
+
+    gSerialHandle = OpenConfiguredPort(portName);
+    if (!IsSerialOpen()) {
+        gSerialPortName = "";
         return false;
     }
 
     gSerialPortName = portName;
-    gSerialStatus = "Connected";
+    gReconnectPending = false;
+    ResetPanelLink();
     return true;
 }
 
 void CloseSerialPort()
 {
-    if (gSerialHandle != INVALID_HANDLE_VALUE) {
-        CloseHandle(gSerialHandle);
-        gSerialHandle = INVALID_HANDLE_VALUE;
+    CancelBackgroundOpen();
+
+    if (IsSerialOpen()) {
+        CloseSerialHandle(gSerialHandle);
+        gSerialHandle = kInvalidSerialHandle;
+        PostEvent(kEventPortClosed, gSerialPortName);
     }
-    gSerialStatus = "Disconnected";
     gSerialPortName = "";
+    gReconnectPending = false;  // 用户主动断开，不自动重连
+    gReconnectDelay = kReconnectDelayMin;
+}
+
+float RefreshPortsCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop,
+                          int inCounter, void* inRefcon);
+
+// 读写出错（设备拔出、对端关闭）时关闭端口，由刷新回调等待设备重新出现
+void DropSerialConnection(int errorCode)
+{
+    CloseSerialHandle(gSerialHandle);
+    gSerialHandle = kInvalidSerialHandle;
+    PostEvent(kEventPortClosed, gSerialPortName, errorCode);
+    gSerialPortName = "";
+    gReconnectPending = gLinkVerified;  // 只自动重连确认过的面板
+
+    // 已连接时刷新间隔是 30 秒，改为马上开始等待重连
+    XPLMSetFlightLoopCallbackInterval(RefreshPortsCallback, 1.0f, 1, nullptr);
 }
 
 // 前向声明
 void BuildPortMenu();
 
-// 定时刷新COM端口列表
+// 定时刷新串口列表
+// 首次调用在第一帧之后，完整的端口发现不会拖慢插件加载
 float RefreshPortsCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop,
                           int inCounter, void* inRefcon)
 {
-    // 刷新可用端口列表
-    gAvailablePorts = EnumerateSerialPorts();
+    // 接管后台打开的结果
+    bool wasPending = gBackgroundOpen.worker.joinable();
+    bool openPending = PollBackgroundOpen();
+    bool openFinished = wasPending && !openPending;
+    float now = XPLMGetElapsedTime();
+
+    // 后台线程已经枚举过设备，直接使用它得到的端口列表
+    bool portsRefreshed = false;
+    if (openFinished && gBackgroundOpen.listed) {
+        gAvailablePorts = gBackgroundOpen.ports;
+        portsRefreshed = true;
+    }
+
+    // 连接意外断开后，上次的设备重新出现时自动重连
+    // 设备是否在列表中由后台线程判断：不在时每秒再查一次，不写日志；
+    // 在列表中但打不开（如被其他程序占用）时按指数退避重试
+    if (openFinished && gReconnectPending) {
+        if (gBackgroundOpen.found) {
+            gNextReconnectTime = now + gReconnectDelay;
+            gReconnectDelay = std::min(gReconnectDelay * 2.0f, kReconnectDelayMax);
+        } else {
+            gNextReconnectTime = now + kReconnectDelayMin;
+        }
+    }
+    if (gReconnectPending && !openPending && !IsSerialOpen() && now >= gNextReconnectTime) {
+        StartBackgroundOpen(gPrefs.deviceId, gPrefs.portName);
+        openPending = true;
+    }
+
+    // 其他情况按刷新间隔在这里枚举；后台打开进行中或等待重连时由后台线程提供端口列表
+    if (!portsRefreshed && !openPending && !gReconnectPending) {
+        gAvailablePorts = EnumerateSerialPorts();
+        portsRefreshed = true;
+    }
+
+    // 首次发现或后台连接刚完成时，下拉框选中当前连接的端口
+    // （inCounter 是全局飞行循环计数，重新加载插件后不从 1 开始，不能用来判断首次调用）
+    static bool first = true;
+    if (portsRefreshed && (first || openFinished)) {
+        first = false;
+        for (size_t i = 0; i < gAvailablePorts.size(); i++) {
+            if (gAvailablePorts[i] == gSerialPortName) {
+                gSelectedPortIndex = static_cast<int>(i);
+            }
+        }
+    }
 
     // 更新菜单
     BuildPortMenu();
 
     // 根据是否有设备连接返回不同的刷新间隔
-    if (gSerialHandle != INVALID_HANDLE_VALUE) {
+    if (openPending) {
+        return 0.5f;   // 后台正在连接：尽快接管结果
+    } else if (gReconnectPending) {
+        return 1.0f;   // 等待断开的设备重新出现
+    } else if (IsSerialOpen()) {
         return 30.0f;  // 已连接：30秒刷新一次
     } else {
         return 10.0f;  // 未连接：10秒刷新一次
     }
 }
-#endif
+
+// 当前连接状态（由串口句柄推导，不再保存状态字符串）
+const char* SerialStateText()
+{
+    if (IsSerialOpen()) return "Connected";
+    if (gBackgroundOpen.worker.joinable()) return "Connecting...";
+    if (gReconnectPending) return "Waiting for device...";
+    return "Disconnected";
+}
 
 // 构建串口菜单
 void BuildPortMenu()
 {
-#ifdef _WIN32
     if (!gPortMenuID) return;
 
     // 清除所有菜单项
@@ -220,7 +1501,6 @@ void BuildPortMenu()
                              (void*)gPortMenuRefs.back().c_str(), 0);
         }
     }
-#endif
 }
 
 // 菜单回调函数
@@ -237,39 +1517,47 @@ void MenuHandlerCallback(void* inMenuRef, void* inItemRef)
             XPLMSetWindowIsVisible(gWindow, !isVisible);
         }
     }
+    else if (strcmp(itemRef, "toggle_history") == 0) {
+        // 切换走势图/事件日志
+        gShowHistory = !gShowHistory;
+    }
+    else if (strcmp(itemRef, "export_history") == 0) {
+        ExportHistoryCSV();
+    }
     else if (strcmp(itemRef, "refresh_ports") == 0) {
         // 刷新串口列表
-#ifdef _WIN32
         gAvailablePorts = EnumerateSerialPorts();
         BuildPortMenu();
-        if (gAvailablePorts.empty()) {
-            gSerialStatus = "No serial ports found";
-        } else {
-            gSerialStatus = std::to_string(gAvailablePorts.size()) + " port(s) found";
-        }
-#endif
+        PostEvent(kEventPortsScanned, "", 0, static_cast<int32_t>(gAvailablePorts.size()));
     }
     else if (strncmp(itemRef, "port:", 5) == 0) {
         // 选择串口
-#ifdef _WIN32
         std::string portName = itemRef + 5; // 跳过 "port:" 前缀
         if (OpenSerialPort(portName)) {
             // 连接成功
         }
-#endif
     }
 }
 
-// 绘制函数
-void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
+// 读取一个浮点字段并做变化检测，返回对应的脏位
+uint32_t UpdateFloatField(ChangeFilter& filter, float raw, float& out, FCUField field)
 {
-    int l, t, r, b;
-    XPLMGetWindowGeometry(inWindowID, &l, &t, &r, &b);
+    bool changed = filter.update(raw);
+    out = filter.value();
+    return changed ? (1u << field) : 0u;
+}
 
-    // 绘制背景
-    XPLMSetGraphicsState(0, 0, 0, 0, 1, 0, 0);
-    XPLMDrawTranslucentDarkBox(l, t, r, b);
+// 读取一个整型字段，返回对应的脏位
+uint32_t UpdateIntField(int raw, int& out, FCUField field)
+{
+    if (raw == out) return 0u;
+    out = raw;
+    return 1u << field;
+}
 
+// 采样 FCU DataRef，生成带脏位掩码的快照
+void SampleFCU()
+{
     // 动态查找未找到的 DataRef（飞机加载后才注册）
     if (!gHDGTRKMode) gHDGTRKMode = XPLMFindDataRef("AirbusFBW/HDGTRKmode");
     if (!gAP1) gAP1 = XPLMFindDataRef("AirbusFBW/AP1Engage");
@@ -285,14 +1573,6 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
     float alt = gALT ? XPLMGetDataf(gALT) : 0.0f;
     float vs  = gVS  ? XPLMGetDataf(gVS)  : 0.0f;
 
-    // 读取模式
-    int hdgTrkMode = gHDGTRKMode ? XPLMGetDatai(gHDGTRKMode) : 0;
-    int machMode   = gMachMode   ? XPLMGetDatai(gMachMode)   : 0;
-
-    // 读取 AP 状态和 FPA
-    int ap1 = gAP1 ? XPLMGetDatai(gAP1) : 0;
-    int ap2 = gAP2 ? XPLMGetDatai(gAP2) : 0;
-
     // 读取 FPA 字符串
     float fpa = 0.0f;
     if (gFPA) {
@@ -304,107 +1584,273 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
         }
     }
 
-    // 读取自动管理模式
-    int spdManaged = gSPDmanaged ? XPLMGetDatai(gSPDmanaged) : 0;
-    int hdgManaged = gHDGmanaged ? XPLMGetDatai(gHDGmanaged) : 0;
-    int apVerticalMode = gAPVerticalMode ? XPLMGetDatai(gAPVerticalMode) : 0;
+    FCUSnapshot& snap = gFCUSnapshot;
+    uint32_t dirty = 0;
+
+    // 模式和 AP 状态
+    dirty |= UpdateIntField(gHDGTRKMode ? XPLMGetDatai(gHDGTRKMode) : 0, snap.hdgTrkMode, kFieldHDGTRKMode);
+    dirty |= UpdateIntField(gMachMode ? XPLMGetDatai(gMachMode) : 0, snap.machMode, kFieldMachMode);
+    dirty |= UpdateIntField(gSPDmanaged ? XPLMGetDatai(gSPDmanaged) : 0, snap.spdManaged, kFieldSPDManaged);
+    dirty |= UpdateIntField(gHDGmanaged ? XPLMGetDatai(gHDGmanaged) : 0, snap.hdgManaged, kFieldHDGManaged);
+    dirty |= UpdateIntField(gAPVerticalMode ? XPLMGetDatai(gAPVerticalMode) : 0, snap.apVerticalMode, kFieldVerticalMode);
+    dirty |= UpdateIntField(gAP1 ? XPLMGetDatai(gAP1) : 0, snap.ap1, kFieldAP1);
+    dirty |= UpdateIntField(gAP2 ? XPLMGetDatai(gAP2) : 0, snap.ap2, kFieldAP2);
+
+    // SPD/MACH 共用一个字段，切换单位时重新初始化对应检测器
+    if (dirty & (1u << kFieldMachMode)) {
+        gSPDFilter.reset();
+        gMachFilter.reset();
+    }
+    dirty |= UpdateFloatField(snap.machMode ? gMachFilter : gSPDFilter, spd, snap.spd, kFieldSPD);
+    dirty |= UpdateFloatField(gHDGFilter, hdg, snap.hdg, kFieldHDG);
+    dirty |= UpdateFloatField(gALTFilter, alt, snap.alt, kFieldALT);
+    dirty |= UpdateFloatField(gVSFilter, vs, snap.vs, kFieldVS);
+    dirty |= UpdateFloatField(gFPAFilter, fpa, snap.fpa, kFieldFPA);
+
+    snap.dirty = dirty;
+    if (dirty) {
+        snap.sequence++;
+    }
+}
+
+// 每帧采样 FCU 状态
+float SampleFCUCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop,
+                        int inCounter, void* inRefcon)
+{
+    SampleFCU();
+    RecordHistory(XPLMGetElapsedTime());
+    return -1.0f;  // 每帧调用
+}
 
-    // 拼接显示字符串
+// 格式化 FCU 显示文本的一行（只依赖快照中的量化值）
+std::string FormatFCULine(const FCUSnapshot& s, int line)
+{
     std::ostringstream oss;
     oss << std::fixed << std::setprecision(1);
 
-    oss << "========== ToLiss FCU ==========\n";
+    switch (line) {
+    case kLineTitle:
+        oss << "========== ToLiss FCU ==========";
+        break;
+
+    case kLineSPD:
+        // 速度显示
+        if (s.spdManaged) {
+            // 自动模式：显示 --- 和 ·
+            oss << "·MACH: ---";
+        } else if (s.machMode) {
+            oss << " MACH: " << std::setprecision(3) << s.spd;
+        } else {
+            oss << " SPD:  " << std::setw(3) << static_cast<int>(s.spd) << " kts";
+        }
+        break;
+
+    case kLineHDG:
+        // 航向显示
+        if (s.hdgManaged) {
+            // 自动模式：显示 --- 和 ·
+            oss << "·HDG:  --- deg";
+        } else if (s.hdgTrkMode) {
+            oss << " TRK:  " << std::setfill('0') << std::setw(3) << static_cast<int>(s.hdg)
+                << std::setfill(' ') << " deg";
+        } else {
+            oss << " HDG:  " << std::setfill('0') << std::setw(3) << static_cast<int>(s.hdg)
+                << std::setfill(' ') << " deg";
+        }
+        break;
+
+    case kLineALT:
+        // 高度显示
+        if (s.apVerticalMode == 1) {
+            // CLB 模式：显示高度数值，带 ·
+            oss << "·ALT:  " << std::setw(5) << static_cast<int>(s.alt) << " ft";
+        } else if (s.apVerticalMode == 101) {
+            // OP CLB 模式：不带 ·，显示 -----
+            oss << " ALT:  ----- ft";
+        } else {
+            // 其他模式：正常显示
+            oss << " ALT:  " << std::setw(5) << static_cast<int>(s.alt) << " ft";
+        }
+        break;
+
+    case kLineVS: {
+        // 垂直速度/FPA 显示（V/S 已由检测器量化到百位）
+        int vsValue = static_cast<int>(std::lround(s.vs));
+        if (s.apVerticalMode == 1 || s.apVerticalMode == 101) {
+            // CLB 或 OP CLB 模式：显示 -----
+            if (s.hdgTrkMode) {
+                oss << " FPA:  ----- deg";
+            } else {
+                oss << " V/S:  ----- fpm";
+            }
+        } else if (s.apVerticalMode == 107 || !s.hdgTrkMode) {
+            // VS 模式或 HDG/VS：不带 ·，显示带符号的四位数
+            oss << " V/S:  " << (vsValue >= 0 ? "+" : "")
+                << std::setfill('0') << std::setw(4) << abs(vsValue) << std::setfill(' ') << " fpm";
+        } else {
+            // FPA显示，带符号
+            oss << " FPA:  " << (s.fpa >= 0 ? "+" : "")
+                << std::setprecision(1) << std::setw(4) << s.fpa << " deg";
+        }
+        break;
+    }
 
-    // 速度显示
-    if (spdManaged) {
-        // 自动模式：显示 --- 和 ·
-        oss << "·MACH: ---\n";
-    } else if (machMode) {
-        oss << " MACH: " << std::setprecision(3) << spd << "\n";
-    } else {
-        oss << " SPD:  " << std::setw(3) << static_cast<int>(spd) << " kts\n";
+    case kLineSeparator:
+        oss << "--------------------------------";
+        break;
+
+    case kLineMode:
+        oss << "Mode: " << (s.hdgTrkMode ? "TRK/FPA" : "HDG/VS ") << " | ";
+        oss << (s.machMode ? "MACH" : "SPD ");
+        break;
+
+    case kLineAP:
+        oss << "AP1: " << (s.ap1 ? "ON " : "OFF") << "  |  ";
+        oss << "AP2: " << (s.ap2 ? "ON " : "OFF");
+        break;
+
+    case kLineFooter:
+        oss << "================================";
+        break;
     }
 
-    // 航向显示
-    if (hdgManaged) {
-        // 自动模式：显示 --- 和 ·
-        oss << "·HDG:  --- deg\n";
-    } else if (hdgTrkMode) {
-        oss << " TRK:  " << std::setfill('0') << std::setw(3) << static_cast<int>(hdg)
-            << std::setfill(' ') << " deg\n";
-    } else {
-        oss << " HDG:  " << std::setfill('0') << std::setw(3) << static_cast<int>(hdg)
-            << std::setfill(' ') << " deg\n";
+    return oss.str();
+}
+
+// 按快照的 dirty 掩码更新缓存的文本行
+// 窗口隐藏时会错过中间的快照，此时无法知道累计变化了哪些字段，全部重新格式化
+void UpdateFCULines(const FCUSnapshot& s)
+{
+    if (gFCULinesValid && s.sequence == gFCULinesSequence) return;
+
+    bool rebuildAll = !gFCULinesValid || s.sequence != gFCULinesSequence + 1;
+    for (int line = 0; line < kLineCount; line++) {
+        if (rebuildAll || (s.dirty & kLineFields[line])) {
+            gFCULines[line] = FormatFCULine(s, line);
+        }
+    }
+    gFCULinesSequence = s.sequence;
+    gFCULinesValid = true;
+}
+
+// 走势图区域（由绘制函数记录，供鼠标回调判断点击）
+int gHistoryAreaTop = 0;
+int gHistoryAreaBottom = 0;
+
+// 在 [left, right] x [bottom, top] 范围内绘制一个通道的走势图，最新样本在最右侧
+void DrawSparkline(const HistoryTier& tier, int channel, int left, int right, int bottom, int top)
+{
+    if (tier.count == 0) return;
+
+    // 纵向按显示窗口内的最小/最大值自动缩放（fmin/fmax 跳过没有值的样本）
+    float lo = NAN;
+    float hi = NAN;
+    for (int i = 0; i < tier.count; i++) {
+        int idx = tier.Index(i);
+        lo = std::fmin(lo, tier.minv[channel][idx]);
+        hi = std::fmax(hi, tier.maxv[channel][idx]);
+    }
+    if (std::isnan(lo)) return;
+    if (hi - lo < 1e-6f) {
+        lo -= 1.0f;
+        hi += 1.0f;
     }
 
-    // 高度显示
-    if (apVerticalMode == 1) {
-        // CLB 模式：显示高度数值，带 ·
-        oss << "·ALT:  " << std::setw(5) << static_cast<int>(alt) << " ft\n";
-    } else if (apVerticalMode == 101) {
-        // OP CLB 模式：不带 ·，显示 -----
-        oss << " ALT:  ----- ft\n";
-    } else {
-        // 其他模式：正常显示
-        oss << " ALT:  " << std::setw(5) << static_cast<int>(alt) << " ft\n";
+    float xStep = static_cast<float>(right - left) / (HistoryTier::kCapacity - 1);
+    float xStart = right - xStep * (tier.count - 1);
+    float yScale = (top - bottom) / (hi - lo);
+
+    XPLMSetGraphicsState(0, 0, 0, 0, 1, 0, 0);
+
+    // 最小/最大包络
+    glColor4f(0.3f, 0.5f, 0.3f, 1.0f);
+    glBegin(GL_LINES);
+    for (int i = 0; i < tier.count; i++) {
+        int idx = tier.Index(i);
+        if (tier.maxv[channel][idx] > tier.minv[channel][idx]) {
+            float x = xStart + xStep * i;
+            glVertex2f(x, bottom + (tier.minv[channel][idx] - lo) * yScale);
+            glVertex2f(x, bottom + (tier.maxv[channel][idx] - lo) * yScale);
+        }
     }
+    glEnd();
 
-    // 垂直速度/FPA 显示
-    if (apVerticalMode == 1 || apVerticalMode == 101) {
-        // CLB 或 OP CLB 模式：显示 -----
-        if (hdgTrkMode) {
-            oss << " FPA:  ----- deg\n";
-        } else {
-            oss << " V/S:  ----- fpm\n";
-        }
-    } else if (apVerticalMode == 107) {
-        // VS 模式：不带 ·，显示带符号的四位数，精确到百位
-        int vsValue = static_cast<int>(vs);
-        // 四舍五入到百位
-        if (vsValue >= 0) {
-            vsValue = (vsValue + 50) / 100 * 100;
-        } else {
-            vsValue = (vsValue - 50) / 100 * 100;
+    // 最后值折线，在没有值的样本处断开
+    glColor4f(0.0f, 1.0f, 0.0f, 1.0f);
+    glBegin(GL_LINE_STRIP);
+    for (int i = 0; i < tier.count; i++) {
+        int idx = tier.Index(i);
+        if (std::isnan(tier.last[channel][idx])) {
+            glEnd();
+            glBegin(GL_LINE_STRIP);
+            continue;
         }
-        oss << " V/S:  " << (vsValue >= 0 ? "+" : "")
-            << std::setfill('0') << std::setw(4) << abs(vsValue) << std::setfill(' ') << " fpm\n";
-    } else {
-        // 其他模式：正常显示
-        if (hdgTrkMode) {
-            // FPA显示，带符号
-            oss << " FPA:  " << (fpa >= 0 ? "+" : "")
-                << std::setprecision(1) << std::setw(4) << fpa << " deg\n";
-        } else {
-            // V/S精确到百位，显示为带符号的4位数
-            int vsValue = static_cast<int>(vs);
-            if (vsValue >= 0) {
-                vsValue = (vsValue + 50) / 100 * 100;
+        glVertex2f(xStart + xStep * i, bottom + (tier.last[channel][idx] - lo) * yScale);
+    }
+    glEnd();
+}
+
+// 绘制所有通道的走势图，每个通道一行
+void DrawHistory(int left, int right, int bottom, int top)
+{
+    const HistoryTier& tier = gHistoryTiers[gHistoryViewTier];
+    float white[3] = {1.0f, 1.0f, 1.0f};
+    float gray[3] = {0.7f, 0.7f, 0.7f};
+
+    // 标题行：当前分辨率和时间跨度
+    std::ostringstream title;
+    title << "History " << tier.name << " x " << HistoryTier::kCapacity
+          << " (" << static_cast<int>(tier.interval * HistoryTier::kCapacity / 60.0f) << " min, click to change)";
+    std::string titleText = title.str();
+    XPLMDrawString(gray, left, top - 10, const_cast<char*>(titleText.c_str()), nullptr, xplmFont_Basic);
+    top -= 15;
+
+    int rowHeight = (top - bottom) / kHistChannelCount;
+    if (rowHeight < 10) return;
+
+    for (int c = 0; c < kHistChannelCount; c++) {
+        int rowTop = top - c * rowHeight;
+        int rowBottom = rowTop - rowHeight + 2;
+
+        std::ostringstream label;
+        label << kHistoryChannelNames[c];
+        if (tier.count > 0) {
+            float value = tier.last[c][tier.Newest()];
+            if (std::isnan(value)) {
+                label << " ---";
             } else {
-                vsValue = (vsValue - 50) / 100 * 100;
+                label << " " << value;
             }
-            oss << " V/S:  " << (vsValue >= 0 ? "+" : "")
-                << std::setfill('0') << std::setw(4) << abs(vsValue) << std::setfill(' ') << " fpm\n";
         }
+        std::string labelText = label.str();
+        XPLMDrawString(white, left, rowBottom + 2, const_cast<char*>(labelText.c_str()), nullptr, xplmFont_Basic);
+
+        DrawSparkline(tier, c, left + 90, right, rowBottom, rowTop);
     }
+}
+
+// 绘制函数
+void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
+{
+    int l, t, r, b;
+    XPLMGetWindowGeometry(inWindowID, &l, &t, &r, &b);
 
-    oss << "--------------------------------\n";
-    oss << "Mode: " << (hdgTrkMode ? "TRK/FPA" : "HDG/VS ") << " | ";
-    oss << (machMode ? "MACH" : "SPD ") << "\n";
-    oss << "AP1: " << (ap1 ? "ON " : "OFF") << "  |  ";
-    oss << "AP2: " << (ap2 ? "ON " : "OFF") << "\n";
-    oss << "================================";
+    // 绘制背景
+    XPLMSetGraphicsState(0, 0, 0, 0, 1, 0, 0);
+    XPLMDrawTranslucentDarkBox(l, t, r, b);
 
-    // 添加串口状态信息
-    oss << "\n\n======== Serial Port ==========\n";
-    if (gSerialPortName.empty()) {
-        oss << "Port: None\n";
-    } else {
-        oss << "Port: " << gSerialPortName << "\n";
-    }
-    oss << "Status: " << gSerialStatus << "\n";
-    oss << "================================";
+    // 只重新格式化快照中变化字段所在的行
+    UpdateFCULines(gFCUSnapshot);
 
-    std::string text = oss.str();
+    // 串口状态信息
+    char serialLines[5][96];
+    snprintf(serialLines[0], sizeof(serialLines[0]), "======== Serial Port ==========");
+    snprintf(serialLines[1], sizeof(serialLines[1]), "Port: %s",
+             gSerialPortName.empty() ? "None" : gSerialPortName.c_str());
+    snprintf(serialLines[2], sizeof(serialLines[2]), "Status: %s", SerialStateText());
+    snprintf(serialLines[3], sizeof(serialLines[3]), "Link: rx %u  tx %u  crc %u  drop %u",
+             gLinkStats.rxFrames, gLinkStats.txFrames, gLinkStats.crcErrors, gLinkStats.txDropped);
+    snprintf(serialLines[4], sizeof(serialLines[4]), "================================");
 
     // 绘制文本
     float white[3] = {1.0f, 1.0f, 1.0f};
@@ -412,22 +1858,41 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
     float yellow[3] = {1.0f, 1.0f, 0.0f};
     int lineHeight = 15;
     int y = t - 18;
-    std::istringstream lines(text);
-    std::string line;
-    int lineNum = 0;
 
-    while (std::getline(lines, line)) {
-        float* color = white;
+    // 标题和分隔线（以及 --- 占位）用绿色
+    auto drawLine = [&](const char* line, bool isTitle) {
+        float* color = (isTitle || strstr(line, "===") || strstr(line, "---")) ? green : white;
+        XPLMDrawString(color, l + 10, y, const_cast<char*>(line), nullptr, xplmFont_Basic);
+        y -= lineHeight;
+    };
+    for (int line = 0; line < kLineCount; line++) {
+        drawLine(gFCULines[line].c_str(), line == kLineTitle);
+    }
+    y -= lineHeight;  // 空一行
+    for (const char* line : serialLines) {
+        drawLine(line, false);
+    }
 
-        // 标题和分隔线用绿色
-        if (lineNum == 0 || line.find("===") != std::string::npos ||
-            line.find("---") != std::string::npos) {
-            color = green;
-        }
+    // 文本与串口控件之间的空间显示走势图或事件日志
+    int logBottom = b + 58;  // 串口控件上方
+    gHistoryAreaTop = y + lineHeight - 5;
+    gHistoryAreaBottom = logBottom;
+    if (gShowHistory) {
+        DrawHistory(l + 10, r - 10, gHistoryAreaBottom, gHistoryAreaTop);
+        y = logBottom - lineHeight;
+    }
+
+    // 绘制事件日志：最新事件在最下面
+    float gray[3] = {0.7f, 0.7f, 0.7f};
+    int logRows = (y >= logBottom) ? (y - logBottom) / lineHeight + 1 : 0;
+    int historySize = static_cast<int>(gEventHistory.size());
+    gEventScroll = std::max(0, std::min(gEventScroll, historySize - logRows));
 
-        XPLMDrawString(color, l + 10, y, const_cast<char*>(line.c_str()), nullptr, xplmFont_Basic);
+    int logEnd = historySize - gEventScroll;
+    int logStart = std::max(0, logEnd - logRows);
+    for (int i = logStart; i < logEnd; i++) {
+        XPLMDrawString(gray, l + 10, y, const_cast<char*>(gEventHistory[i].c_str()), nullptr, xplmFont_Basic);
         y -= lineHeight;
-        lineNum++;
     }
 
     // 绘制串口选择UI
@@ -458,7 +1923,6 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
     glEnd();
 
     // 绘制下拉框文本
-#ifdef _WIN32
     std::string dropdownText = "None";
     if (!gAvailablePorts.empty() && gSelectedPortIndex >= 0 &&
         gSelectedPortIndex < static_cast<int>(gAvailablePorts.size())) {
@@ -467,9 +1931,6 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
         gSelectedPortIndex = 0;
         dropdownText = gAvailablePorts[0];
     }
-#else
-    std::string dropdownText = "N/A (Windows only)";
-#endif
 
     XPLMDrawString(white, dropdownX + 5, dropdownY + 5,
                    const_cast<char*>(dropdownText.c_str()), nullptr, xplmFont_Basic);
@@ -479,7 +1940,6 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
                    const_cast<char*>("v"), nullptr, xplmFont_Basic);
 
     // 如果下拉列表展开，绘制列表项
-#ifdef _WIN32
     if (gShowDropdown && !gAvailablePorts.empty()) {
         int itemHeight = 18;
         for (size_t i = 0; i < gAvailablePorts.size(); i++) {
@@ -513,7 +1973,6 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
                          nullptr, xplmFont_Basic);
         }
     }
-#endif
 
     // 绘制连接/断开按钮
     int buttonX = dropdownX + dropdownWidth + 10;
@@ -524,15 +1983,11 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
     XPLMSetGraphicsState(0, 0, 0, 0, 1, 0, 0);
 
     // 按钮背景 - 根据连接状态改变颜色
-#ifdef _WIN32
-    if (gSerialHandle != INVALID_HANDLE_VALUE) {
+    if (IsSerialOpen()) {
         glColor4f(0.5f, 0.2f, 0.2f, 1.0f);  // 已连接 - 红色系
     } else {
         glColor4f(0.2f, 0.5f, 0.2f, 1.0f);  // 未连接 - 绿色系
     }
-#else
-    glColor4f(0.5f, 0.5f, 0.5f, 1.0f);  // 非Windows平台 - 灰色
-#endif
     glBegin(GL_QUADS);
     glVertex2i(buttonX, buttonY);
     glVertex2i(buttonX + buttonWidth, buttonY);
@@ -550,11 +2005,7 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
     glEnd();
 
     // 按钮文本
-#ifdef _WIN32
-    const char* buttonText = (gSerialHandle != INVALID_HANDLE_VALUE) ? "Disconnect" : "Connect";
-#else
-    const char* buttonText = "N/A";
-#endif
+    const char* buttonText = (IsSerialOpen()) ? "Disconnect" : "Connect";
     XPLMDrawString(yellow, buttonX + 10, buttonY + 5,
                    const_cast<char*>(buttonText), nullptr, xplmFont_Basic);
 }
@@ -562,7 +2013,8 @@ void DrawWindowCallback(XPLMWindowID inWindowID, void* inRefcon)
 // 鼠标回调
 int DummyMouse(XPLMWindowID inWindowID, int x, int y, int isDown, void* inRefcon)
 {
-    if (!isDown) return 0;  // 只处理按下事件
+    // 只处理按下事件（isDown 是 XPLMMouseStatus，拖动和松开分别为 2 和 3）
+    if (isDown != xplm_MouseDown) return 0;
 
     int l, t, r, b;
     XPLMGetWindowGeometry(inWindowID, &l, &t, &r, &b);
@@ -578,7 +2030,12 @@ int DummyMouse(XPLMWindowID inWindowID, int x, int y, int isDown, void* inRefcon
     int buttonWidth = 80;
     int buttonHeight = 20;
 
-#ifdef _WIN32
+    // 点击走势图切换分辨率层
+    if (gShowHistory && !gShowDropdown && y >= gHistoryAreaBottom && y <= gHistoryAreaTop) {
+        gHistoryViewTier = (gHistoryViewTier + 1) % kHistoryTierCount;
+        return 1;
+    }
+
     // 检查是否点击了下拉框
     if (x >= dropdownX && x <= dropdownX + dropdownWidth &&
         y >= dropdownY && y <= dropdownY + dropdownHeight) {
@@ -607,7 +2064,7 @@ int DummyMouse(XPLMWindowID inWindowID, int x, int y, int isDown, void* inRefcon
     // 检查是否点击了连接/断开按钮
     if (x >= buttonX && x <= buttonX + buttonWidth &&
         y >= buttonY && y <= buttonY + buttonHeight) {
-        if (gSerialHandle != INVALID_HANDLE_VALUE) {
+        if (IsSerialOpen()) {
             // 当前已连接，执行断开
             CloseSerialPort();
         } else {
@@ -616,7 +2073,7 @@ int DummyMouse(XPLMWindowID inWindowID, int x, int y, int isDown, void* inRefcon
                 gSelectedPortIndex < static_cast<int>(gAvailablePorts.size())) {
                 OpenSerialPort(gAvailablePorts[gSelectedPortIndex]);
             } else {
-                gSerialStatus = "No port selected";
+                PostEvent(kEventNoPortSelected);
             }
         }
         gShowDropdown = false;  // 关闭下拉列表
@@ -628,11 +2085,18 @@ int DummyMouse(XPLMWindowID inWindowID, int x, int y, int isDown, void* inRefcon
         gShowDropdown = false;
         return 1;
     }
-#endif
 
     return 0;
 }
 
+// 鼠标滚轮回调：滚动事件日志
+int EventLogMouseWheel(XPLMWindowID inWindowID, int x, int y, int wheel, int clicks, void* inRefcon)
+{
+    gEventScroll += clicks;  // 向上滚动查看更早的事件，绘制时再限制范围
+    if (gEventScroll < 0) gEventScroll = 0;
+    return 1;
+}
+
 // 键盘回调
 void DummyKey(XPLMWindowID, char, XPLMKeyFlags, char, void*, int) { }
 
@@ -646,6 +2110,9 @@ PLUGIN_API int XPluginStart(char* outName, char* outSig, char* outDesc)
     strcpy(outSig, "dzc.toliss.fcu.monitor");
     strcpy(outDesc, "Display ToLiss FCU Data in X-Plane 11/12.");
 
+    // 使用系统原生路径（macOS 默认是 HFS 路径，无法直接用于 std::ofstream）
+    XPLMEnableFeature("XPLM_USE_NATIVE_PATHS", 1);
+
     // 获取 FCU 值 DataRefs
     gSPD = XPLMFindDataRef("sim/cockpit/autopilot/airspeed");
     gHDG = XPLMFindDataRef("sim/cockpit/autopilot/heading_mag");
@@ -666,24 +2133,13 @@ PLUGIN_API int XPluginStart(char* outName, char* outSig, char* outDesc)
     gHDGmanaged = XPLMFindDataRef("AirbusFBW/HDGmanaged");
     gAPVerticalMode = XPLMFindDataRef("AirbusFBW/APVerticalMode");
 
-    // 初始化串口
-#ifdef _WIN32
-    gAvailablePorts = EnumerateSerialPorts();
-    if (!gAvailablePorts.empty()) {
-        if (gAvailablePorts.size() == 1) {
-            // 只有一个串口，自动连接
-            if (OpenSerialPort(gAvailablePorts[0])) {
-                // 连接成功
-            }
-        } else {
-            // 多个串口，默认尝试第一个
-            OpenSerialPort(gAvailablePorts[0]);
-            // TODO: 将来可以添加用户选择功能
-        }
-    } else {
-        gSerialStatus = "No serial ports found";
+    // 读取窗口位置和上次连接的设备
+    LoadPrefs();
+
+    // 初始化串口：查找和打开上次成功连接的设备都在后台线程中进行，完整的端口发现推迟到第一帧之后
+    if (!gPrefs.deviceId.empty() || !gPrefs.portName.empty()) {
+        StartBackgroundOpen(gPrefs.deviceId, gPrefs.portName);
     }
-#endif
 
     // 创建插件菜单
     gMenuItemIdx = XPLMAppendMenuItem(XPLMFindPluginsMenu(), "FCU Display", nullptr, 0);
@@ -691,10 +2147,11 @@ PLUGIN_API int XPluginStart(char* outName, char* outSig, char* outDesc)
 
     // 添加菜单项
     XPLMAppendMenuItem(gMenuID, "Show/Hide UI", (void*)"toggle_ui", 0);
+    XPLMAppendMenuItem(gMenuID, "Show/Hide History", (void*)"toggle_history", 0);
+    XPLMAppendMenuItem(gMenuID, "Export History CSV", (void*)"export_history", 0);
     XPLMAppendMenuSeparator(gMenuID);
 
     // 添加串口相关菜单
-#ifdef _WIN32
     XPLMAppendMenuItem(gMenuID, "Refresh Ports", (void*)"refresh_ports", 0);
 
     // 创建串口选择子菜单
@@ -703,7 +2160,6 @@ PLUGIN_API int XPluginStart(char* outName, char* outSig, char* outDesc)
 
     // 初始化串口菜单
     BuildPortMenu();
-#endif
 
     // 创建窗口
     XPLMCreateWindow_t params;
@@ -714,37 +2170,49 @@ PLUGIN_API int XPluginStart(char* outName, char* outSig, char* outDesc)
     params.handleMouseClickFunc = DummyMouse;
     params.handleKeyFunc = DummyKey;
     params.handleCursorFunc = DummyCursor;
-    params.handleMouseWheelFunc = nullptr;
+    params.handleMouseWheelFunc = EventLogMouseWheel;
     params.refcon = nullptr;
-    params.left = 50;
-    params.top = 600;
-    params.right = 380;
-    params.bottom = 320;  // 调整高度以容纳串口信息和UI控件
+    params.left = gPrefs.windowLeft;
+    params.top = gPrefs.windowTop;
+    params.right = gPrefs.windowRight;
+    params.bottom = gPrefs.windowBottom;
     params.decorateAsFloatingWindow = xplm_WindowDecorationRoundRectangle;
 
     gWindow = XPLMCreateWindowEx(&params);
     XPLMSetWindowPositioningMode(gWindow, xplm_WindowPositionFree, -1);
     XPLMSetWindowTitle(gWindow, "ToLiss FCU Monitor");
 
-    // 注册定时刷新回调（仅Windows）
-#ifdef _WIN32
-    XPLMRegisterFlightLoopCallback(RefreshPortsCallback, 10.0f, nullptr);
-#endif
+    // 注册 FCU 采样回调（每帧）
+    XPLMRegisterFlightLoopCallback(SampleFCUCallback, -1.0f, nullptr);
+
+    // 注册事件日志输出回调
+    XPLMRegisterFlightLoopCallback(DrainEventsCallback, 0.25f, nullptr);
+
+    // 注册串口刷新和面板链路回调
+    XPLMRegisterFlightLoopCallback(RefreshPortsCallback, -1.0f, nullptr);
+    XPLMRegisterFlightLoopCallback(PanelLinkCallback, -1.0f, nullptr);
 
     return 1;
 }
 
 PLUGIN_API void XPluginStop(void)
 {
+    // 注销 FCU 采样回调
+    XPLMUnregisterFlightLoopCallback(SampleFCUCallback, nullptr);
+    XPLMUnregisterFlightLoopCallback(DrainEventsCallback, nullptr);
+
     // 注销定时刷新回调
-#ifdef _WIN32
     XPLMUnregisterFlightLoopCallback(RefreshPortsCallback, nullptr);
-#endif
+    XPLMUnregisterFlightLoopCallback(PanelLinkCallback, nullptr);
 
     // 关闭串口
-#ifdef _WIN32
     CloseSerialPort();
-#endif
+
+    // 写出剩余的事件日志
+    DrainEvents();
+
+    // 保存窗口位置
+    SavePrefs();
 
     // 销毁窗口
     if (gWindow) {
@@ -753,12 +2221,10 @@ PLUGIN_API void XPluginStop(void)
     }
 
     // 销毁菜单
-#ifdef _WIN32
     if (gPortMenuID) {
         XPLMDestroyMenu(gPortMenuID);
         gPortMenuID = nullptr;
     }
-#endif
     if (gMenuID) {
         XPLMDestroyMenu(gMenuID);
         gMenuID = nullptr;
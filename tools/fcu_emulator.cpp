@@ -0,0 +1,637 @@
+// FCU 面板模拟器：创建一个伪终端 (PTY)，按 fcu_protocol.h 与插件通信，
+// 回放脚本场景（高速旋钮、连续按键、垃圾数据、突然断开），并统计丢帧、迟到和乱序。
+//
+// 用法示例：
+//   ./fcu_emulator --link /tmp/ttyFCU soak
+//   FCU_SERIAL_PORT=/tmp/ttyFCU ./X-Plane-x86_64
+//
+// 场景脚本每行一条命令（# 开头为注释）：
+//   wait <秒>
+//   encoder <SPD|HDG|ALT|VS> <每次格数> <频率Hz> <秒>
+//   buttons <总次数> <每组次数> <组间隔ms>
+//   garbage <字节数>
+//   disconnect <秒>
+//   repeat <次数>        整个脚本重复的次数，0 表示一直运行到 Ctrl-C
+
+#include "fcu_protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+// 内置场景
+struct BuiltinScenario {
+    const char* name;
+    const char* script;
+};
+
+const BuiltinScenario kBuiltinScenarios[] = {
+    {"idle",       "wait 10\n"},
+    {"encoder",    "encoder SPD 1 1000 10\nencoder SPD -1 1000 10\nwait 2\n"},
+    {"buttons",    "buttons 200 20 100\nwait 2\n"},
+    {"garbage",    "garbage 256\nencoder HDG 1 100 2\ngarbage 1024\nencoder HDG -1 100 2\nwait 2\n"},
+    {"disconnect", "encoder ALT 1 50 2\ndisconnect 2\nencoder ALT -1 50 2\nwait 2\n"},
+    {"soak",       "encoder SPD 1 1000 5\nbuttons 100 10 50\ngarbage 512\nencoder HDG -1 1000 5\n"
+                   "disconnect 1\nencoder VS 1 200 5\nwait 1\nrepeat 0\n"},
+};
+
+struct Step {
+    enum Kind { kWait, kEncoder, kButtons, kGarbage, kDisconnect } kind;
+    int control = 0;
+    int delta = 0;
+    double rate = 0.0;     // encoder: 每秒次数
+    double seconds = 0.0;  // wait/encoder/disconnect: 持续时间
+    int count = 0;         // buttons: 总次数; garbage: 字节数
+    int burst = 0;         // buttons: 每组次数
+    double gapMs = 0.0;    // buttons: 组间隔
+};
+
+struct Script {
+    std::vector<Step> steps;
+    int repeat = 1;
+};
+
+struct Options {
+    std::string linkPath;
+    std::vector<std::string> scenarios;
+    std::vector<std::string> scriptFiles;
+    double lateMs = 100.0;
+    double ackTimeoutSec = 2.0;
+    double reportSec = 5.0;
+    bool waitHost = true;
+    bool verbose = false;
+    unsigned seed = 1;
+};
+
+// 统计
+struct Stats {
+    uint64_t inputsSent = 0;
+    uint64_t acks = 0;
+    uint64_t acksLate = 0;
+    uint64_t acksOutOfOrder = 0;
+    uint64_t acksUnexpected = 0;   // 确认了未发送或已超时的输入
+    uint64_t inputsLost = 0;       // 超时未确认
+    uint64_t garbageBytes = 0;
+    uint64_t disconnects = 0;
+
+    uint64_t hostFrames = 0;
+    uint64_t hostDropped = 0;      // 插件帧序号缺口
+    uint64_t hostOutOfOrder = 0;
+    uint64_t hostLate = 0;         // State 帧间隔超过心跳周期
+    uint64_t hostCrcErrors = 0;
+    uint64_t hostSkippedBytes = 0;
+
+    double rttSumMs = 0.0;
+    double rttMaxMs = 0.0;
+    uint64_t rttHistogram[1001] = {};  // 1 ms 一格，最后一格为 >= 1000 ms
+
+    double RttPercentile(double p) const {
+        if (acks == 0) return 0.0;
+        uint64_t target = static_cast<uint64_t>(p * acks);
+        uint64_t seen = 0;
+        for (int i = 0; i <= 1000; i++) {
+            seen += rttHistogram[i];
+            if (seen > target) return i;
+        }
+        return 1000.0;
+    }
+};
+
+volatile sig_atomic_t gStop = 0;
+
+void HandleSignal(int) { gStop = 1; }
+
+double Now()
+{
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return duration<double>(steady_clock::now() - start).count();
+}
+
+int ParseControl(const std::string& name)
+{
+    if (name == "SPD") return fcu::kControlSPD;
+    if (name == "HDG") return fcu::kControlHDG;
+    if (name == "ALT") return fcu::kControlALT;
+    if (name == "VS")  return fcu::kControlVS;
+    return -1;
+}
+
+bool ParseScript(std::istream& in, const std::string& source, Script& script)
+{
+    std::string line;
+    int lineNum = 0;
+    while (std::getline(in, line)) {
+        lineNum++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+
+        std::istringstream words(line);
+        std::string command;
+        if (!(words >> command)) continue;
+
+        Step step;
+        bool ok = true;
+        if (command == "wait") {
+            step.kind = Step::kWait;
+            ok = static_cast<bool>(words >> step.seconds) && step.seconds >= 0.0;
+        } else if (command == "encoder") {
+            std::string control;
+            step.kind = Step::kEncoder;
+            ok = static_cast<bool>(words >> control >> step.delta >> step.rate >> step.seconds);
+            step.control = ParseControl(control);
+            ok = ok && step.control >= 0 && step.rate > 0.0 && step.seconds >= 0.0 &&
+                 step.delta >= -127 && step.delta <= 127;
+        } else if (command == "buttons") {
+            step.kind = Step::kButtons;
+            ok = static_cast<bool>(words >> step.count >> step.burst >> step.gapMs) &&
+                 step.count >= 0 && step.burst > 0 && step.gapMs >= 0.0;
+        } else if (command == "garbage") {
+            step.kind = Step::kGarbage;
+            ok = static_cast<bool>(words >> step.count) && step.count >= 0;
+        } else if (command == "disconnect") {
+            step.kind = Step::kDisconnect;
+            ok = static_cast<bool>(words >> step.seconds) && step.seconds >= 0.0;
+        } else if (command == "repeat") {
+            ok = static_cast<bool>(words >> script.repeat) && script.repeat >= 0;
+            if (ok) continue;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "%s:%d: invalid command: %s\n", source.c_str(), lineNum, line.c_str());
+            return false;
+        }
+        script.steps.push_back(step);
+    }
+    return true;
+}
+
+// PTY 主设备端，从设备端的路径通过 --link 提供给插件
+class PtyPort {
+public:
+    ~PtyPort() { Close(); }
+
+    bool Open(const std::string& linkPath) {
+        mMaster = posix_openpt(O_RDWR | O_NOCTTY);
+        if (mMaster < 0 || grantpt(mMaster) != 0 || unlockpt(mMaster) != 0) {
+            perror("posix_openpt");
+            Close();
+            return false;
+        }
+        mSlavePath = ptsname(mMaster);
+
+        // 自己保持从设备打开：设置原始模式，并避免插件未连接时主设备读到 EIO
+        mSlave = open(mSlavePath.c_str(), O_RDWR | O_NOCTTY);
+        termios tty;
+        if (mSlave < 0 || tcgetattr(mSlave, &tty) != 0) {
+            perror(mSlavePath.c_str());
+            Close();
+            return false;
+        }
+        cfmakeraw(&tty);
+        cfsetispeed(&tty, B115200);
+        cfsetospeed(&tty, B115200);
+        tcsetattr(mSlave, TCSANOW, &tty);
+
+        fcntl(mMaster, F_SETFL, fcntl(mMaster, F_GETFL) | O_NONBLOCK);
+
+        if (!linkPath.empty()) {
+            unlink(linkPath.c_str());
+            if (symlink(mSlavePath.c_str(), linkPath.c_str()) != 0) {
+                perror(linkPath.c_str());
+            }
+        }
+        return true;
+    }
+
+    void Close() {
+        if (mSlave >= 0) close(mSlave);
+        if (mMaster >= 0) close(mMaster);
+        mSlave = mMaster = -1;
+    }
+
+    int fd() const { return mMaster; }
+    const std::string& slavePath() const { return mSlavePath; }
+
+private:
+    int mMaster = -1;
+    int mSlave = -1;
+    std::string mSlavePath;
+};
+
+class Emulator {
+public:
+    Emulator(const Options& options) : mOptions(options), mRandom(options.seed) {
+        mSentTime.assign(65536, -1.0);
+    }
+
+    int Run(const Script& script) {
+        if (!Reconnect()) return 1;
+
+        int pass = 0;
+        mStart = mLastReport = Now();
+        while (!gStop && (script.repeat == 0 || pass < script.repeat)) {
+            for (size_t i = 0; i < script.steps.size() && !gStop; i++) {
+                RunStep(script.steps[i]);
+            }
+            pass++;
+        }
+
+        // 等待最后的确认
+        Pump(Now() + mOptions.ackTimeoutSec);
+        ExpirePending(true);
+        Report(true);
+
+        bool clean = mStats.inputsLost == 0 && mStats.acksOutOfOrder == 0 &&
+                     mStats.hostDropped == 0 && mStats.hostOutOfOrder == 0;
+        return clean ? 0 : 2;
+    }
+
+private:
+    // 创建新的 PTY 并等待插件连上（收到第一帧）
+    bool Reconnect() {
+        mPort.Close();
+        if (!mPort.Open(mOptions.linkPath)) return false;
+
+        printf("PTY %s%s%s\n", mPort.slavePath().c_str(),
+               mOptions.linkPath.empty() ? "" : " -> ", mOptions.linkPath.c_str());
+        fflush(stdout);
+
+        mDecoder.Reset();
+        mHaveHostSeq = false;
+        mHaveAckSeq = false;
+        mLastStateTime = -1.0;
+
+        if (mOptions.waitHost) {
+            printf("Waiting for plugin...\n");
+            fflush(stdout);
+            uint64_t framesBefore = mStats.hostFrames;
+            while (!gStop && mStats.hostFrames == framesBefore) {
+                Pump(Now() + 0.1);
+            }
+        }
+        return true;
+    }
+
+    void RunStep(const Step& step) {
+        double start = Now();
+        switch (step.kind) {
+            case Step::kWait:
+                Pump(start + step.seconds);
+                break;
+
+            case Step::kEncoder: {
+                // 按固定频率发送，落后时补发，保证总次数 = 频率 * 时长
+                long total = static_cast<long>(step.rate * step.seconds);
+                for (long n = 0; n < total && !gStop; n++) {
+                    Pump(start + n / step.rate);
+                    SendInput(step.control, fcu::kActionTurn, step.delta);
+                }
+                break;
+            }
+
+            case Step::kButtons: {
+                std::uniform_int_distribution<int> control(0, fcu::kControlCount - 1);
+                std::uniform_int_distribution<int> action(fcu::kActionPush, fcu::kActionPull);
+                for (int n = 0; n < step.count && !gStop; n++) {
+                    if (n > 0 && n % step.burst == 0) {
+                        Pump(Now() + step.gapMs / 1000.0);
+                    }
+                    int c = control(mRandom);
+                    // AP 按钮只有按下
+                    int a = (c >= fcu::kControlAP1) ? fcu::kActionPush : action(mRandom);
+                    SendInput(c, a, 0);
+                }
+                break;
+            }
+
+            case Step::kGarbage: {
+                std::uniform_int_distribution<int> byte(0, 255);
+                std::vector<uint8_t> data(step.count);
+                for (auto& b : data) b = static_cast<uint8_t>(byte(mRandom));
+                Write(data.data(), data.size());
+                mStats.garbageBytes += data.size();
+                break;
+            }
+
+            case Step::kDisconnect:
+                // 先处理已到达的确认，其余未确认的输入计为丢失
+                Pump(start + 0.05);
+                ExpirePending(true);
+                mPort.Close();
+                mStats.disconnects++;
+                printf("Disconnected for %.1f s\n", step.seconds);
+                fflush(stdout);
+                while (!gStop && Now() < start + step.seconds) {
+                    usleep(10000);
+                    MaybeReport();
+                }
+                if (!Reconnect()) gStop = 1;
+                break;
+        }
+    }
+
+    void SendInput(int control, int action, int delta) {
+        fcu::InputPayload input;
+        input.control = static_cast<uint8_t>(control);
+        input.action = static_cast<uint8_t>(action);
+        input.delta = static_cast<int8_t>(delta);
+
+        uint8_t payload[fcu::kFrameMaxPayload];
+        uint8_t frame[fcu::kFrameMaxSize];
+        uint16_t seq = mTxSeq++;
+        size_t size = fcu::EncodeFrame(fcu::kFrameInput, seq, payload, fcu::EncodeInput(input, payload), frame);
+
+        // 序号回绕到仍未确认的输入时，旧的那个按丢失处理
+        if (mSentTime[seq] >= 0.0) {
+            mStats.inputsLost++;
+        }
+        mSentTime[seq] = Now();
+        mPending.push_back(seq);
+        mStats.inputsSent++;
+        Write(frame, size);
+    }
+
+    void Write(const uint8_t* data, size_t size) {
+        while (size > 0 && !gStop) {
+            ssize_t n = write(mPort.fd(), data, size);
+            if (n > 0) {
+                data += n;
+                size -= static_cast<size_t>(n);
+            } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                // 插件读得慢，PTY 缓冲区已满：边等边处理回复
+                Pump(Now() + 0.001);
+            } else {
+                return;
+            }
+        }
+    }
+
+    // 处理插件发来的数据直到 deadline
+    void Pump(double deadline) {
+        do {
+            double remaining = deadline - Now();
+            int timeoutMs = remaining > 0.0 ? std::min(10, static_cast<int>(remaining * 1000.0)) : 0;
+
+            pollfd pfd = {mPort.fd(), POLLIN, 0};
+            if (poll(&pfd, 1, timeoutMs) > 0 && (pfd.revents & POLLIN)) {
+                uint8_t buffer[4096];
+                ssize_t n;
+                while ((n = read(mPort.fd(), buffer, sizeof(buffer))) > 0) {
+                    for (ssize_t i = 0; i < n; i++) {
+                        HandleByte(buffer[i]);
+                    }
+                }
+            }
+            ExpirePending(false);
+            MaybeReport();
+        } while (!gStop && Now() < deadline);
+    }
+
+    void HandleByte(uint8_t byte) {
+        mDecoder.Put(byte);
+        fcu::FrameDecoder::Result result;
+        while ((result = mDecoder.Next()) != fcu::FrameDecoder::kNeedMore) {
+            if (result == fcu::FrameDecoder::kCRCError) {
+                mStats.hostCrcErrors++;
+            } else {
+                HandleFrame(mDecoder.frame());
+            }
+        }
+        mStats.hostSkippedBytes += mDecoder.TakeSkipped();
+    }
+
+    void HandleFrame(const fcu::Frame& frame) {
+        double now = Now();
+        mStats.hostFrames++;
+
+        // 插件所有帧共用一个序号
+        if (mHaveHostSeq) {
+            int16_t diff = static_cast<int16_t>(frame.seq - mExpectedHostSeq);
+            if (diff > 0) {
+                mStats.hostDropped += diff;
+            } else if (diff < 0) {
+                mStats.hostOutOfOrder++;
+            }
+            if (diff >= 0) mExpectedHostSeq = frame.seq + 1;
+        } else {
+            mHaveHostSeq = true;
+            mExpectedHostSeq = frame.seq + 1;
+        }
+
+        if (frame.type == fcu::kFrameAck) {
+            fcu::AckPayload ack;
+            if (fcu::DecodeAck(frame.payload, frame.len, ack)) HandleAck(ack.inputSeq, now);
+        } else if (frame.type == fcu::kFrameState) {
+            // 插件至少每秒发送一次 State
+            if (mLastStateTime >= 0.0 && now - mLastStateTime > 1.5) {
+                mStats.hostLate++;
+            }
+            mLastStateTime = now;
+
+            fcu::StatePayload state;
+            if (mOptions.verbose && fcu::DecodeState(frame.payload, frame.len, state)) {
+                printf("STATE spd %.3f hdg %d alt %d vs %d fpa %.1f vmode %d flags %02x\n",
+                       state.spd1000 / 1000.0, state.hdg, state.alt, state.vs, state.fpa10 / 10.0,
+                       state.verticalMode, state.flags);
+            }
+        }
+    }
+
+    void HandleAck(uint16_t seq, double now) {
+        if (mSentTime[seq] < 0.0) {
+            mStats.acksUnexpected++;
+            return;
+        }
+
+        if (mHaveAckSeq && static_cast<int16_t>(seq - mLastAckSeq) < 0) {
+            mStats.acksOutOfOrder++;
+        } else {
+            mLastAckSeq = seq;
+            mHaveAckSeq = true;
+        }
+
+        double rttMs = (now - mSentTime[seq]) * 1000.0;
+        mSentTime[seq] = -1.0;
+        mStats.acks++;
+        mStats.rttSumMs += rttMs;
+        mStats.rttMaxMs = std::max(mStats.rttMaxMs, rttMs);
+        mStats.rttHistogram[std::min(1000, static_cast<int>(rttMs))]++;
+        if (rttMs > mOptions.lateMs) {
+            mStats.acksLate++;
+        }
+    }
+
+    // 超时未确认的输入计为丢失；all 为 true 时清空全部（断开连接或结束时）
+    void ExpirePending(bool all) {
+        double cutoff = Now() - mOptions.ackTimeoutSec;
+        while (!mPending.empty()) {
+            uint16_t seq = mPending.front();
+            if (mSentTime[seq] >= 0.0) {
+                if (!all && mSentTime[seq] > cutoff) break;
+                mSentTime[seq] = -1.0;
+                mStats.inputsLost++;
+            }
+            mPending.pop_front();
+        }
+    }
+
+    void MaybeReport() {
+        if (Now() - mLastReport >= mOptions.reportSec) {
+            Report(false);
+        }
+    }
+
+    void Report(bool final) {
+        double now = Now();
+        double elapsed = now - mStart;
+        double interval = now - mLastReport;
+        uint64_t sentDelta = mStats.inputsSent - mLastReportSent;
+        mLastReport = now;
+        mLastReportSent = mStats.inputsSent;
+
+        const Stats& s = mStats;
+        printf("[%7.1fs] in: sent %llu (%.0f/s) acked %llu lost %llu late %llu ooo %llu | "
+               "rtt avg %.1f p99 %.0f max %.1f ms | host: frames %llu dropped %llu ooo %llu late %llu crc %llu\n",
+               elapsed, (unsigned long long)s.inputsSent, interval > 0.0 ? sentDelta / interval : 0.0,
+               (unsigned long long)s.acks, (unsigned long long)s.inputsLost,
+               (unsigned long long)s.acksLate, (unsigned long long)s.acksOutOfOrder,
+               s.acks ? s.rttSumMs / s.acks : 0.0, s.RttPercentile(0.99), s.rttMaxMs,
+               (unsigned long long)s.hostFrames, (unsigned long long)s.hostDropped,
+               (unsigned long long)s.hostOutOfOrder, (unsigned long long)s.hostLate,
+               (unsigned long long)s.hostCrcErrors);
+
+        if (final) {
+            printf("\n==== Summary (%.1f s) ====\n", elapsed);
+            printf("inputs sent        %llu\n", (unsigned long long)s.inputsSent);
+            printf("inputs acked       %llu\n", (unsigned long long)s.acks);
+            printf("inputs lost        %llu\n", (unsigned long long)s.inputsLost);
+            printf("acks late (>%.0fms) %llu\n", mOptions.lateMs, (unsigned long long)s.acksLate);
+            printf("acks out of order  %llu\n", (unsigned long long)s.acksOutOfOrder);
+            printf("acks unexpected    %llu\n", (unsigned long long)s.acksUnexpected);
+            printf("rtt avg/p50/p99/max %.1f / %.0f / %.0f / %.1f ms\n",
+                   s.acks ? s.rttSumMs / s.acks : 0.0, s.RttPercentile(0.5), s.RttPercentile(0.99), s.rttMaxMs);
+            printf("host frames        %llu\n", (unsigned long long)s.hostFrames);
+            printf("host dropped       %llu\n", (unsigned long long)s.hostDropped);
+            printf("host out of order  %llu\n", (unsigned long long)s.hostOutOfOrder);
+            printf("host state late    %llu\n", (unsigned long long)s.hostLate);
+            printf("host crc errors    %llu\n", (unsigned long long)s.hostCrcErrors);
+            printf("host skipped bytes %llu\n", (unsigned long long)s.hostSkippedBytes);
+            printf("garbage bytes sent %llu\n", (unsigned long long)s.garbageBytes);
+            printf("disconnects        %llu\n", (unsigned long long)s.disconnects);
+        }
+        fflush(stdout);
+    }
+
+    const Options& mOptions;
+    std::mt19937 mRandom;
+    PtyPort mPort;
+    fcu::FrameDecoder mDecoder;
+    Stats mStats;
+
+    uint16_t mTxSeq = 0;
+    std::vector<double> mSentTime;   // 按输入序号索引的发送时间，-1 表示未在等待确认
+    std::deque<uint16_t> mPending;   // 按发送顺序排列的输入序号
+
+    bool mHaveHostSeq = false;
+    uint16_t mExpectedHostSeq = 0;
+    bool mHaveAckSeq = false;
+    uint16_t mLastAckSeq = 0;
+    double mLastStateTime = -1.0;
+
+    double mStart = 0.0;
+    double mLastReport = 0.0;
+    uint64_t mLastReportSent = 0;
+};
+
+void PrintUsage(const char* program)
+{
+    printf("Usage: %s [options] [scenario...]\n\n", program);
+    printf("Options:\n");
+    printf("  --link PATH       symlink to the PTY slave, kept across disconnects\n");
+    printf("  --script FILE     run a scenario script file\n");
+    printf("  --late-ms N       acks slower than N ms count as late (default 100)\n");
+    printf("  --ack-timeout S   inputs not acked within S seconds count as lost (default 2)\n");
+    printf("  --report-sec S    print statistics every S seconds (default 5)\n");
+    printf("  --no-wait         start without waiting for the plugin to connect\n");
+    printf("  --seed N          random seed for buttons/garbage (default 1)\n");
+    printf("  -v, --verbose     print every state frame received\n\n");
+    printf("Scenarios:");
+    for (const auto& scenario : kBuiltinScenarios) printf(" %s", scenario.name);
+    printf("\n\nExit status is 2 if any input was lost or any frame was dropped or out of order.\n");
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--link" && hasValue) options.linkPath = argv[++i];
+        else if (arg == "--script" && hasValue) options.scriptFiles.push_back(argv[++i]);
+        else if (arg == "--late-ms" && hasValue) options.lateMs = atof(argv[++i]);
+        else if (arg == "--ack-timeout" && hasValue) options.ackTimeoutSec = atof(argv[++i]);
+        else if (arg == "--report-sec" && hasValue) options.reportSec = atof(argv[++i]);
+        else if (arg == "--seed" && hasValue) options.seed = static_cast<unsigned>(atoi(argv[++i]));
+        else if (arg == "--no-wait") options.waitHost = false;
+        else if (arg == "-v" || arg == "--verbose") options.verbose = true;
+        else if (arg == "-h" || arg == "--help") { PrintUsage(argv[0]); return 0; }
+        else if (!arg.empty() && arg[0] != '-') options.scenarios.push_back(arg);
+        else { PrintUsage(argv[0]); return 1; }
+    }
+    if (options.scenarios.empty() && options.scriptFiles.empty()) {
+        options.scenarios.push_back("soak");
+    }
+
+    // 多个场景按顺序拼接；repeat 取最后一个指定的值
+    Script script;
+    for (const auto& name : options.scenarios) {
+        const BuiltinScenario* found = nullptr;
+        for (const auto& scenario : kBuiltinScenarios) {
+            if (name == scenario.name) found = &scenario;
+        }
+        if (!found) {
+            fprintf(stderr, "Unknown scenario: %s\n", name.c_str());
+            return 1;
+        }
+        std::istringstream in(found->script);
+        if (!ParseScript(in, name, script)) return 1;
+    }
+    for (const auto& path : options.scriptFiles) {
+        std::ifstream in(path);
+        if (!in) {
+            fprintf(stderr, "Cannot open script: %s\n", path.c_str());
+            return 1;
+        }
+        if (!ParseScript(in, path, script)) return 1;
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    Emulator emulator(options);
+    int status = emulator.Run(script);
+
+    if (!options.linkPath.empty()) {
+        unlink(options.linkPath.c_str());
+    }
+    return status;
+}